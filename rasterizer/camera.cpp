@@ -0,0 +1,28 @@
+#include "camera.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace rasterizer {
+
+glm::mat4 ViewPort::projection(float near, float far) const {
+    // scale the viewport from its own distance to the near plane, Y is flipped to grow upwards
+    const float scale  = near / getZ();
+    const float left   = LEFT_DOWN_POS.x * scale;
+    const float right  = RIGHT_UP_POS.x * scale;
+    const float bottom = -LEFT_DOWN_POS.y * scale;
+    const float top    = -RIGHT_UP_POS.y * scale;
+
+    glm::mat4 m{0.f};
+    m[0][0] = 2.f * near / (right - left);
+    m[1][1] = 2.f * near / (top - bottom);
+    m[2][0] = (right + left) / (right - left);
+    m[2][1] = (top + bottom) / (top - bottom);
+    m[2][2] = -(far + near) / (far - near);
+    m[2][3] = -1.f;
+    m[3][2] = -2.f * far * near / (far - near);
+    return m;
+}
+
+glm::mat4 Camera::view() const { return glm::lookAt(position, target, up); }
+
+}   // namespace rasterizer
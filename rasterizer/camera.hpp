@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+/* Coordinate system:
+ * The middle of the screen should be (0, 0)
+ * X grows positivly to the right
+ * Y grows negativly down
+ * Z grows positivly in the direction through the screen
+ */
+namespace rasterizer {
+
+class ViewPort {
+    // The viewport is relative to the camera
+    // Assume the center of the viewport is the position of the viewport
+  public:
+    ViewPort(){};
+    ~ViewPort(){};
+
+    float getZ() const { return this->LEFT_DOWN_POS[2]; }
+    glm::vec3 getLDP() const { return LEFT_DOWN_POS; }
+    glm::vec3 getRUP() const { return RIGHT_UP_POS; }
+
+    /**
+     * Perspective projection of the frustum through the viewport
+     */
+    glm::mat4 projection(float near, float far) const;
+
+  private:
+    /* +--------RUP
+     * |         |
+     * LDP-------+
+     */
+    glm::vec3 LEFT_DOWN_POS{-.5f, .5f, 1.f};   // remember the Y axis grows downwards
+    glm::vec3 RIGHT_UP_POS{.5f, -.5f, 1.f};
+};
+
+class Camera {
+    // Assume the position of the camera is the point where we are looking from
+    // Assume we are looking from the position towards the target
+  public:
+    Camera(){};
+    Camera(glm::vec3 position, glm::vec3 target) : position{position}, target{target} {};
+    ~Camera(){};
+
+    glm::vec3 getPosition() const { return this->position; }
+    glm::vec3 getTarget() const { return this->target; }
+    float getNear() const { return this->near; }
+    float getFar() const { return this->far; }
+
+    glm::mat4 view() const;
+
+  private:
+    glm::vec3 position{0.0f, 0.0f, 3.0f};
+    glm::vec3 target{0.0f, 0.0f, 0.0f};
+    glm::vec3 up{0.0f, 1.0f, 0.0f};
+    float near{.1f};
+    float far{100.f};
+};
+
+}   // namespace rasterizer
@@ -0,0 +1,243 @@
+#include "cluster.hpp"
+#include "drawing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+uint32_t spreadBits(uint32_t v) {
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// 30 bit morton code of a point in the unit cube
+uint32_t morton3(glm::vec3 p) {
+    const glm::vec3 q = glm::clamp(p * 1023.f, 0.f, 1023.f);
+    return spreadBits((uint32_t) q.x) | (spreadBits((uint32_t) q.y) << 1) | (spreadBits((uint32_t) q.z) << 2);
+}
+
+// Bounding sphere around the center of the bounding box of the points
+void boundingSphere(const std::vector<glm::vec3> &points, glm::vec3 &center, float &radius) {
+    glm::vec3 lo{std::numeric_limits<float>::max()};
+    glm::vec3 hi{-std::numeric_limits<float>::max()};
+    for (const glm::vec3 &p : points) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    center = (lo + hi) * .5f;
+    radius = 0.f;
+    for (const glm::vec3 &p : points) {
+        radius = std::max(radius, glm::length(p - center));
+    }
+}
+
+/**
+ * Screen bounds relative to the region and nearest depth of a model space sphere
+ * @return false if the sphere reaches behind the camera, then nothing is known
+ */
+bool projectSphere(glm::vec3 center, float radius, const glm::mat4 &mvp, const drawing::Region &region, glm::vec2 &boxMin, glm::vec2 &boxMax, float &nearest) {
+    boxMin  = glm::vec2{std::numeric_limits<float>::max()};
+    boxMax  = glm::vec2{-std::numeric_limits<float>::max()};
+    nearest = -std::numeric_limits<float>::max();
+    // the corners of the bounding box of the sphere
+    for (int i = 0; i < 8; i++) {
+        const glm::vec3 corner = center + radius * glm::vec3{i & 1 ? 1.f : -1.f, i & 2 ? 1.f : -1.f, i & 4 ? 1.f : -1.f};
+        const glm::vec4 clip   = mvp * glm::vec4(corner, 1.f);
+        if (clip.w <= 0.f || clip.z < -clip.w) {
+            return false;
+        }
+        const glm::vec3 screen = pipeline::toScreen(clip, region.frameWidth, region.frameHeight);
+        const glm::vec2 pixel  = glm::vec2(screen) - glm::vec2(region.x, region.y);
+        boxMin                 = glm::min(boxMin, pixel);
+        boxMax                 = glm::max(boxMax, pixel);
+        nearest                = std::max(nearest, screen.z);
+    }
+    return true;
+}
+
+}   // namespace
+
+namespace cluster {
+
+OcclusionBuffer::OcclusionBuffer(const float *zbuffer, int width, int height, int tileSize) : tileSize{tileSize} {
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesY = (height + tileSize - 1) / tileSize;
+    tiles.assign((size_t) tilesX * tilesY, std::numeric_limits<float>::max());
+    for (int y = 0; y < height; y++) {
+        float *row = tiles.data() + (size_t) (y / tileSize) * tilesX;
+        for (int x = 0; x < width; x++) {
+            row[x / tileSize] = std::min(row[x / tileSize], zbuffer[x + (size_t) y * width]);
+        }
+    }
+}
+
+bool OcclusionBuffer::isOccluded(glm::vec2 boxMin, glm::vec2 boxMax, float nearest) const {
+    if (tiles.empty()) {
+        return false;
+    }
+    const int x0 = std::max(0, (int) std::floor(boxMin.x) / tileSize);
+    const int y0 = std::max(0, (int) std::floor(boxMin.y) / tileSize);
+    const int x1 = std::min(tilesX - 1, (int) std::ceil(boxMax.x) / tileSize);
+    const int y1 = std::min(tilesY - 1, (int) std::ceil(boxMax.y) / tileSize);
+    if (x0 > x1 || y0 > y1) {
+        return false;   // off screen, the frustum test handles it
+    }
+    for (int ty = y0; ty <= y1; ty++) {
+        for (int tx = x0; tx <= x1; tx++) {
+            if (tiles[tx + (size_t) ty * tilesX] <= nearest) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+ClusteredModel::ClusteredModel(Model &model, int facesPerCluster, int clustersPerGroup) : model{model} {
+    const int nfaces = model.nfaces();
+    if (nfaces == 0) {
+        return;
+    }
+
+    // order the faces along a morton curve through their centroids
+    const glm::vec3 lo = model.bounding_center() - glm::vec3{model.bounding_radius()};
+    const float scale  = 1.f / std::max(2.f * model.bounding_radius(), 1e-6f);
+    std::vector<std::pair<uint32_t, int>> order(nfaces);
+    for (int i = 0; i < nfaces; i++) {
+        const std::vector<int> face = model.face(i);
+        const glm::vec3 centroid    = (model.vert(face[0]) + model.vert(face[1]) + model.vert(face[2])) / 3.f;
+        order[i]                    = {morton3((centroid - lo) * scale), i};
+    }
+    std::sort(order.begin(), order.end());
+
+    for (int first = 0; first < nfaces; first += facesPerCluster) {
+        Cluster cluster;
+        std::vector<glm::vec3> points;
+        std::vector<glm::vec3> normals;
+        for (int i = first; i < std::min(nfaces, first + facesPerCluster); i++) {
+            const int f                 = order[i].second;
+            const std::vector<int> face = model.face(f);
+            cluster.faces.push_back(f);
+            for (int j = 0; j < 3; j++) {
+                cluster.verts.push_back(face[j]);
+                points.push_back(model.vert(face[j]));
+            }
+            // outward facing for counter clockwise faces
+            const glm::vec3 n = glm::cross(model.vert(face[1]) - model.vert(face[0]), model.vert(face[2]) - model.vert(face[0]));
+            if (glm::length(n) > 0.f) {
+                normals.push_back(glm::normalize(n));
+            }
+        }
+        std::sort(cluster.verts.begin(), cluster.verts.end());
+        cluster.verts.erase(std::unique(cluster.verts.begin(), cluster.verts.end()), cluster.verts.end());
+        boundingSphere(points, cluster.center, cluster.radius);
+
+        glm::vec3 axis{0.f};
+        for (const glm::vec3 &n : normals) {
+            axis += n;
+        }
+        cluster.coneAxis   = glm::length(axis) > 0.f ? glm::normalize(axis) : glm::vec3{0.f, 0.f, 1.f};
+        float minDot       = 1.f;
+        for (const glm::vec3 &n : normals) {
+            minDot = std::min(minDot, glm::dot(n, cluster.coneAxis));
+        }
+        // a cone wider than a half sphere can always be seen from somewhere
+        cluster.coneCutoff = minDot <= 0.f ? 1.f : std::sqrt(1.f - minDot * minDot);
+        clusters.push_back(std::move(cluster));
+    }
+
+    for (int first = 0; first < (int) clusters.size(); first += clustersPerGroup) {
+        Group group{first, std::min((int) clusters.size() - first, clustersPerGroup)};
+        std::vector<glm::vec3> points;
+        for (int c = first; c < first + group.count; c++) {
+            // extreme points of the cluster spheres along the axes
+            for (int axis = 0; axis < 3; axis++) {
+                glm::vec3 offset{0.f};
+                offset[axis] = clusters[c].radius;
+                points.push_back(clusters[c].center + offset);
+                points.push_back(clusters[c].center - offset);
+            }
+        }
+        boundingSphere(points, group.center, group.radius);
+        for (int c = first; c < first + group.count; c++) {
+            group.radius = std::max(group.radius, glm::length(clusters[c].center - group.center) + clusters[c].radius);
+        }
+        groups.push_back(group);
+    }
+    clip.resize(model.nverts());
+}
+
+void ClusteredModel::drawCluster(const Cluster &cluster, const glm::mat4 &mvp, const glm::mat4 &modelMatrix, TGAImage &image, float *zbuffer, const drawing::Region &region) {
+    for (int v : cluster.verts) {
+        clip[v] = mvp * glm::vec4(model.vert(v), 1.f);
+    }
+    for (int f : cluster.faces) {
+        drawing::drawFlatFace(model, f, clip.data(), modelMatrix, image, zbuffer, region);
+    }
+}
+
+CullStats ClusteredModel::draw(const pipeline::Transform &transform, const OcclusionBuffer &previous, TGAImage &image, float *zbuffer) {
+    return draw(transform, previous, image, zbuffer, drawing::Region::full(image.get_width(), image.get_height()));
+}
+
+CullStats ClusteredModel::draw(const pipeline::Transform &transform, const OcclusionBuffer &previous, TGAImage &image, float *zbuffer, const drawing::Region &region) {
+    const glm::mat4 mvp = transform.mvp();
+    // planes of the mvp frustum are in model space, so is the camera. A crop window narrows them to the region.
+    const pipeline::Frustum frustum{pipeline::regionMatrix(region) * mvp};
+    const glm::vec3 eye = glm::vec3(glm::inverse(transform.view * transform.model) * glm::vec4{0.f, 0.f, 0.f, 1.f});
+
+    CullStats stats;
+    stats.clusters = (int) clusters.size();
+    std::vector<int> retest;
+    glm::vec2 boxMin;
+    glm::vec2 boxMax;
+    float nearest;
+    for (const Group &group : groups) {
+        if (!frustum.intersectsSphere(group.center, group.radius)) {
+            stats.frustumCulled += group.count;
+            continue;
+        }
+        const bool groupOccluded = projectSphere(group.center, group.radius, mvp, region, boxMin, boxMax, nearest) && previous.isOccluded(boxMin, boxMax, nearest);
+        for (int c = group.first; c < group.first + group.count; c++) {
+            const Cluster &cluster = clusters[c];
+            if (!frustum.intersectsSphere(cluster.center, cluster.radius)) {
+                stats.frustumCulled++;
+                continue;
+            }
+            const glm::vec3 toCluster = cluster.center - eye;
+            if (glm::dot(toCluster, cluster.coneAxis) >= cluster.coneCutoff * glm::length(toCluster) + cluster.radius) {
+                stats.backfaceCulled++;
+                continue;
+            }
+            if (groupOccluded || (projectSphere(cluster.center, cluster.radius, mvp, region, boxMin, boxMax, nearest) && previous.isOccluded(boxMin, boxMax, nearest))) {
+                retest.push_back(c);
+                continue;
+            }
+            drawCluster(cluster, mvp, transform.model, image, zbuffer, region);
+            stats.drawn++;
+        }
+    }
+
+    if (retest.empty()) {
+        return stats;
+    }
+    // second phase: what the previous frame hid may have been revealed by camera or object movement
+    const OcclusionBuffer current{zbuffer, region.width, region.height};
+    for (int c : retest) {
+        const Cluster &cluster = clusters[c];
+        if (projectSphere(cluster.center, cluster.radius, mvp, region, boxMin, boxMax, nearest) && current.isOccluded(boxMin, boxMax, nearest)) {
+            stats.occluded++;
+            continue;
+        }
+        drawCluster(cluster, mvp, transform.model, image, zbuffer, region);
+        stats.drawn++;
+    }
+    return stats;
+}
+
+}   // namespace cluster
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "model.hpp"
+#include "pipeline.hpp"
+#include "tgaimage.hpp"
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace cluster {
+
+/**
+ * A spatially coherent set of faces with bounds in model space
+ */
+struct Cluster {
+    std::vector<int> faces;
+    std::vector<int> verts;   // unique vertex indices used by the faces
+
+    glm::vec3 center;
+    float radius;
+
+    // every face normal lies within the cone around coneAxis, coneCutoff is the sine of its half angle (1 disables the test)
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+/**
+ * Neighbouring clusters with a bounding sphere around all of them, the top level of the hierarchy
+ */
+struct Group {
+    int first{0};
+    int count{0};
+    glm::vec3 center{0.f};
+    float radius{0.f};
+};
+
+/**
+ * Farthest depth of every tile of a zbuffer.
+ * Anything that is farther away than that everywhere under its screen bounds is hidden.
+ */
+class OcclusionBuffer {
+  public:
+    OcclusionBuffer(){};
+    OcclusionBuffer(const float *zbuffer, int width, int height, int tileSize = 8);
+
+    bool empty() const { return tiles.empty(); }
+
+    /**
+     * @param nearest depth of the closest point of the object, larger is closer
+     */
+    bool isOccluded(glm::vec2 boxMin, glm::vec2 boxMax, float nearest) const;
+
+  private:
+    int tileSize{8};
+    int tilesX{0};
+    int tilesY{0};
+    std::vector<float> tiles{};
+};
+
+struct CullStats {
+    int clusters{0};
+    int frustumCulled{0};
+    int backfaceCulled{0};
+    int occluded{0};
+    int drawn{0};
+};
+
+/**
+ * A model split into clusters at load time so whole clusters can be culled before any per triangle work
+ */
+class ClusteredModel {
+  public:
+    ClusteredModel(Model &model, int facesPerCluster = 128, int clustersPerGroup = 8);
+
+    /**
+     * Culls the clusters against the frustum, their normal cones and the depth of the previous frame,
+     * then draws what is left with drawing::drawFlatFace.
+     * Clusters rejected by occlusion are tested again against this frame's depth and drawn if they turn out visible,
+     * so a moving camera can not make geometry disappear.
+     * rasteRize --clusters draws two frames of a still camera, the second one culls against the depth of the first.
+     * @param previous depth of the previous frame, may be empty
+     */
+    CullStats draw(const pipeline::Transform &transform, const OcclusionBuffer &previous, TGAImage &image, float *zbuffer);
+
+    /**
+     * draw into a crop window: image, zbuffer and the occlusion buffers cover only the region of the frame
+     */
+    CullStats draw(const pipeline::Transform &transform, const OcclusionBuffer &previous, TGAImage &image, float *zbuffer, const drawing::Region &region);
+
+    const std::vector<Cluster> &getClusters() const { return clusters; }
+
+  private:
+    void drawCluster(const Cluster &cluster, const glm::mat4 &mvp, const glm::mat4 &modelMatrix, TGAImage &image, float *zbuffer, const drawing::Region &region);
+
+    Model &model;
+    std::vector<Cluster> clusters{};
+    std::vector<Group> groups{};
+    std::vector<glm::vec4> clip{};   // clip space positions, only valid for the vertices of the cluster being drawn
+};
+
+}   // namespace cluster
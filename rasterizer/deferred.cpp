@@ -0,0 +1,119 @@
+#include "deferred.hpp"
+#include "imageview.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+inline glm::vec2 signNotZero(glm::vec2 v) { return glm::vec2{v.x >= 0.f ? 1.f : -1.f, v.y >= 0.f ? 1.f : -1.f}; }
+
+inline uint32_t toSnorm16(float v) { return (uint32_t) (std::round(std::max(-1.f, std::min(1.f, v)) * 32767.f) + 32767.f); }
+
+inline float fromSnorm16(uint32_t v) { return ((float) v - 32767.f) / 32767.f; }
+
+}   // namespace
+
+namespace deferred {
+
+GBuffer::GBuffer(int width, int height) : width{width}, height{height} {
+    depth.resize((size_t) width * height);
+    normal.resize((size_t) width * height);
+    material.resize((size_t) width * height);
+    clear();
+}
+
+void GBuffer::clear() {
+    std::fill(depth.begin(), depth.end(), -std::numeric_limits<float>::max());
+    std::fill(material.begin(), material.end(), 0);
+}
+
+// Octahedral mapping: the unit sphere is folded onto a square
+uint32_t encodeNormal(glm::vec3 n) {
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 p{n.x, n.y};
+    if (n.z < 0.f) {
+        p = (glm::vec2{1.f} - glm::abs(glm::vec2{p.y, p.x})) * signNotZero(p);
+    }
+    return toSnorm16(p.x) | (toSnorm16(p.y) << 16);
+}
+
+glm::vec3 decodeNormal(uint32_t packed) {
+    glm::vec2 p{fromSnorm16(packed & 0xffff), fromSnorm16(packed >> 16)};
+    glm::vec3 n{p.x, p.y, 1.f - std::abs(p.x) - std::abs(p.y)};
+    if (n.z < 0.f) {
+        glm::vec2 folded = (glm::vec2{1.f} - glm::abs(glm::vec2{n.y, n.x})) * signNotZero(p);
+        n.x              = folded.x;
+        n.y              = folded.y;
+    }
+    return glm::normalize(n);
+}
+
+void drawModel(Model &model, const pipeline::Transform &transform, GBuffer &gbuffer, uint16_t materialId) {
+    drawModel(model, transform, gbuffer, materialId, drawing::Region::full(gbuffer.getWidth(), gbuffer.getHeight()));
+}
+
+void drawModel(Model &model, const pipeline::Transform &transform, GBuffer &gbuffer, uint16_t materialId, const drawing::Region &region) {
+    const int width        = gbuffer.getWidth();
+    const bool vertNormals = model.has_normals();
+    if (!pipeline::isVisible(model, transform, region)) {
+        return;
+    }
+    std::vector<glm::vec4> clip;
+    pipeline::transformVertices(model, transform.mvp(), clip);
+    const glm::mat4 normalMatrix = transform.normalMatrix();
+    for (int i = 0; i < model.nfaces(); i++) {
+        std::vector<int> face = model.face(i);
+        glm::vec4 clip_coords[3];
+        glm::vec3 world_coords[3];
+        glm::vec3 normals[3];
+        for (int j = 0; j < 3; j++) {
+            clip_coords[j]  = clip[face[j]];
+            world_coords[j] = glm::vec3(transform.model * glm::vec4(model.vert(face[j]), 1.f));
+            normals[j]      = glm::vec3(normalMatrix * glm::vec4(model.normal(i, j), 0.f));
+        }
+        const uint32_t faceNormal = encodeNormal(glm::normalize(glm::cross((world_coords[1] - world_coords[0]), (world_coords[2] - world_coords[0]))));
+
+        // back faces are culled on the screen by the pipeline
+        pipeline::drawTriangle(clip_coords, region, gbuffer.depth.data(), [&](int x, int y, glm::vec3 bary) {
+            const size_t idx = x + (size_t) y * width;
+            if (vertNormals) {
+                gbuffer.normal[idx] = encodeNormal(normals[0] * bary.x + normals[1] * bary.y + normals[2] * bary.z);
+            } else {
+                gbuffer.normal[idx] = faceNormal;
+            }
+            gbuffer.material[idx] = materialId;
+        });
+    }
+}
+
+void shade(const GBuffer &gbuffer, const std::vector<Material> &materials, const std::vector<DirectionalLight> &lights, TGAImage &image) {
+    visitImage(image, [&](auto view) {
+        const int width  = std::min(gbuffer.getWidth(), view.getWidth());
+        const int height = std::min(gbuffer.getHeight(), view.getHeight());
+        parallel::forRows(height, [&](int begin, int end) {
+            for (int y = begin; y < end; y++) {
+                for (int x = 0; x < width; x++) {
+                    const size_t idx  = x + (size_t) y * width;
+                    const uint16_t id = gbuffer.material[idx];
+                    if (id == 0 || id >= materials.size()) {
+                        continue;
+                    }
+                    const Material &material = materials[id];
+                    const glm::vec3 normal   = decodeNormal(gbuffer.normal[idx]);
+
+                    glm::vec3 light{material.ambient};
+                    for (const DirectionalLight &l : lights) {
+                        light += l.color * std::max(0.f, glm::dot(normal, -l.direction));
+                    }
+                    const glm::vec3 color = glm::clamp(material.albedo * light, 0.f, 1.f) * 255.f;
+                    view.set(x, y, TGAColor(color.r + .5f, color.g + .5f, color.b + .5f, 255));
+                }
+            }
+        });
+    });
+}
+
+}   // namespace deferred
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "model.hpp"
+#include "pipeline.hpp"
+#include "tgaimage.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace deferred {
+
+struct DirectionalLight {
+    glm::vec3 direction;   // the direction the light travels in
+    glm::vec3 color;
+};
+
+struct Material {
+    glm::vec3 albedo{1.f};
+    float ambient{.1f};
+};
+
+/**
+ * Surface data of the closest fragment of every pixel.
+ * Depth follows the zbuffer convention: larger is closer.
+ */
+class GBuffer {
+  public:
+    GBuffer(int width, int height);
+
+    void clear();
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    std::vector<float> depth;
+    std::vector<uint32_t> normal;     // octahedral encoded, two 16 bit components
+    std::vector<uint16_t> material;   // index into the material table, 0 is no surface
+
+  private:
+    int width;
+    int height;
+};
+
+uint32_t encodeNormal(glm::vec3 n);
+glm::vec3 decodeNormal(uint32_t packed);
+
+/**
+ * Geometry pass: rasterizes the model into the gbuffer, nothing is shaded yet
+ * @param materialId must be > 0
+ */
+void drawModel(Model &model, const pipeline::Transform &transform, GBuffer &gbuffer, uint16_t materialId);
+
+/**
+ * Geometry pass of a crop window, the gbuffer holds only the region of the frame
+ */
+void drawModel(Model &model, const pipeline::Transform &transform, GBuffer &gbuffer, uint16_t materialId, const drawing::Region &region);
+
+/**
+ * Lighting pass: shades every covered pixel exactly once, rows are split over the hardware threads.
+ * Pixels without a surface are left untouched. Shading is per pixel, a gbuffer of a crop window shades into an image of the same window.
+ */
+void shade(const GBuffer &gbuffer, const std::vector<Material> &materials, const std::vector<DirectionalLight> &lights, TGAImage &image);
+
+}   // namespace deferred
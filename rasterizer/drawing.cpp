@@ -1,38 +1,12 @@
 #include "drawing.hpp"
 #include "color.hpp"
+#include "imageview.hpp"
 #include "tgaimage.hpp"
 
 #include <cmath>
 #include <glm/glm.hpp>
 #include <iostream>
 
-// this could be optimized by making sure the triangles provides are clockwise or cclw
-float Sign(glm::vec2 p1, glm::vec2 p2, glm::vec2 p3) { return (p1.x - p3.x) * (p2.y - p3.y) - (p2.x - p3.x) * (p1.y - p3.y); }
-bool pointInTriangle(glm::vec2 pt, glm::vec2 v1, glm::vec2 v2, glm::vec2 v3) {
-    bool b1, b2, b3;
-    b1 = Sign(pt, v1, v2) < 0.0f;
-    b2 = Sign(pt, v2, v3) < 0.0f;
-    b3 = Sign(pt, v3, v1) < 0.0f;
-    return ((b1 == b2) && (b2 == b3));
-}
-
-// Compute barycentric coordinates (u, v, w) for
-// point p with respect to triangle (a, b, c)
-void Barycentric(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c, float &u, float &v, float &w) {
-    glm::vec2 v0 = b - a, v1 = c - a, v2 = p - a;
-    float d00   = glm::dot(v0, v0);
-    float d01   = glm::dot(v0, v1);
-    float d11   = glm::dot(v1, v1);
-    float d20   = glm::dot(v2, v0);
-    float d21   = glm::dot(v2, v1);
-    float denom = d00 * d11 - d01 * d01;
-    v           = (d11 * d20 - d01 * d21) / denom;
-    w           = (d00 * d21 - d01 * d20) / denom;
-    u           = 1.0f - v - w;
-}
-
-
-
 namespace drawing {
 
 void drawLine(int x0, int y0, int x1, int y1, TGAImage &image, TGAColor color) {
@@ -85,95 +59,163 @@ void drawLine(int x0, int y0, int x1, int y1, TGAImage &image, TGAColor color) {
 
 void drawLine(const objects::Line line, TGAImage &image) { drawLine(line.p0[0], line.p0[1], line.p1[0], line.p1[1], image, line.color); }
 
-void drawModelWireFrame(Model &model, TGAImage &image) {
-    const int width  = image.get_width();
-    const int height = image.get_height();
-    for (int i = 0; i < model.nfaces(); i++) {
-        const std::vector<int> face = model.face(i);
-        for (int j = 0; j < 3; j++) {
-            const glm::vec3 v0 = model.vert(face[j]);
-            const glm::vec3 v1 = model.vert(face[(j + 1) % 3]);
-            const int x0       = (v0.x + 1.) * width / 2.;
-            // std::cout << v0[0] << '\n';
-            const int y0 = (v0.y + 1.) * height / 2.;
-            const int x1 = (v1.x + 1.) * width / 2.;
-            const int y1 = (v1.y + 1.) * height / 2.;
-            drawLine(x0, y0, x1, y1, image, white);
+void drawModelWireFrame(Model &model, const pipeline::Transform &transform, TGAImage &image, bool antialiased) {
+    drawModelWireFrame(model, transform, image, Region::full(image.get_width(), image.get_height()), antialiased);
+}
+
+void drawModelWireFrame(Model &model, const pipeline::Transform &transform, TGAImage &image, const Region &region, bool antialiased) {
+    const int width  = region.frameWidth;
+    const int height = region.frameHeight;
+    if (!pipeline::isVisible(model, transform, region)) {
+        return;
+    }
+    std::vector<glm::vec4> clip;
+    pipeline::transformVertices(model, transform.mvp(), clip);
+    const std::vector<glm::ivec2> edges = model.edges();
+    std::vector<glm::vec2> segments;
+    segments.reserve(edges.size() * 2);
+    for (const glm::ivec2 &edge : edges) {
+        glm::vec4 c0 = clip[edge[0]];
+        glm::vec4 c1 = clip[edge[1]];
+        if (!pipeline::clipSegment(c0, c1)) {
+            continue;
         }
+        segments.push_back(glm::vec2(pipeline::toScreen(c0, width, height)));
+        segments.push_back(glm::vec2(pipeline::toScreen(c1, width, height)));
     }
+    drawLines(segments, image, white, region, antialiased);
 }
 
 TGAColor randomColor(float intensity) { return TGAColor(255 * intensity, 255 * intensity, 255 * intensity, 255); }
 
 glm::vec3 light_dir{0.f, 0.f, -1.f};   // define light_dir
-void drawModel(Model &model, TGAImage &image, float *zbuffer) {
-    const int width  = image.get_width();
-    const int height = image.get_height();
-    for (int i = 0; i < model.nfaces(); i++) {
-        std::vector<int> face = model.face(i);
-        glm::vec3 screen_coords[3];
-        glm::vec3 world_coords[3];
-        for (int j = 0; j < 3; j++) {
-            glm::vec3 v      = model.vert(face[j]);
-            screen_coords[j] = glm::vec3{(v.x + 1.) * width / 2., (v.y + 1.) * height / 2., v.z};
-            world_coords[j]  = v;
-        }
 
-        // calculate light based on the world
-        glm::vec3 n     = glm::cross((world_coords[2] - world_coords[0]), (world_coords[1] - world_coords[0]));
-        float intensity = glm::dot(glm::normalize(n), light_dir);
-        if (intensity < 0) {
-            continue;
-        }
+float faceIntensity(const glm::vec3 world[3], glm::vec3 lightDirection) {
+    const glm::vec3 n = glm::cross((world[2] - world[0]), (world[1] - world[0]));
+    return glm::dot(glm::normalize(n), lightDirection);
+}
 
-        const objects::Triangle triangle{screen_coords[0], screen_coords[1], screen_coords[2], randomColor(intensity)};
-        drawTriangle(triangle, image, zbuffer);
-    }
+void drawFlatFace(Model &model, int face, const glm::vec4 *clip, const glm::mat4 &modelMatrix, TGAImage &image, float *zbuffer) {
+    drawFlatFace(model, face, clip, modelMatrix, image, zbuffer, Region::full(image.get_width(), image.get_height()));
 }
 
-void drawTriangle(const objects::Triangle &triangle, TGAImage &image, float *zbuffer) {
-    // drawLine({triangle.p0, triangle.p1, triangle.color}, image);
-    // drawLine({triangle.p1, triangle.p2, triangle.color}, image);
-    // drawLine({triangle.p2, triangle.p0, triangle.color}, image);
+void drawFlatFace(Model &model, int face, const glm::vec4 *clip, const glm::mat4 &modelMatrix, TGAImage &image, float *zbuffer, const Region &region,
+                  const shadow::ShadowMap *shadows) {
+    const std::vector<int> verts = model.face(face);
+    glm::vec4 clip_coords[3];
+    glm::vec3 world_coords[3];
+    for (int j = 0; j < 3; j++) {
+        clip_coords[j]  = clip[verts[j]];
+        world_coords[j] = glm::vec3(modelMatrix * glm::vec4(model.vert(verts[j]), 1.f));
+    }
+
+    // calculate light based on the world
+    const float intensity = faceIntensity(world_coords, shadows ? shadows->getDirection() : light_dir);
+    // the default light sits at the camera, faces turned away from it are back faces. A shadowing light only leaves them dark.
+    if (intensity < 0 && !shadows) {
+        return;
+    }
 
-    int width  = image.get_width();
-    int height = image.get_height();
+    if (shadows) {
+        visitImage(image, [&](auto view) {
+            pipeline::drawTriangle(clip_coords, region, zbuffer, [&](int x, int y, glm::vec3 bary) {
+                const glm::vec3 world = world_coords[0] * bary.x + world_coords[1] * bary.y + world_coords[2] * bary.z;
+                view.set(x, y, randomColor(shadow::shade(intensity, shadows->visibility(world, intensity))));
+            });
+        });
+        return;
+    }
+    const TGAColor color = randomColor(intensity);
+    visitImage(image, [&](auto view) { pipeline::drawTriangle(clip_coords, region, zbuffer, [&](int x, int y, glm::vec3) { view.set(x, y, color); }); });
+}
 
-    glm::vec2 boxMin{width, height};
-    glm::vec2 boxMax{0, 0};
+void drawModel(Model &model, const pipeline::Transform &transform, TGAImage &image, float *zbuffer) {
+    drawModel(model, transform, image, zbuffer, Region::full(image.get_width(), image.get_height()));
+}
 
-    boxMin.x = std::min(boxMin.x, triangle.p0.x);
-    boxMin.x = std::min(boxMin.x, triangle.p1.x);
-    boxMin.x = std::min(boxMin.x, triangle.p2.x);
+void drawModel(Model &model, const pipeline::Transform &transform, TGAImage &image, float *zbuffer, const Region &region, const shadow::ShadowMap *shadows) {
+    if (!pipeline::isVisible(model, transform, region)) {
+        return;
+    }
+    std::vector<glm::vec4> clip;
+    pipeline::transformVertices(model, transform.mvp(), clip);
+    for (int i = 0; i < model.nfaces(); i++) {
+        drawFlatFace(model, i, clip.data(), transform.model, image, zbuffer, region, shadows);
+    }
+}
 
-    boxMin.y = std::min(boxMin.y, triangle.p0.y);
-    boxMin.y = std::min(boxMin.y, triangle.p1.y);
-    boxMin.y = std::min(boxMin.y, triangle.p2.y);
+TGAColor shade(TGAColor color, float intensity) {
+    intensity = std::max(0.f, std::min(1.f, intensity));
+    return TGAColor(color.r * intensity, color.g * intensity, color.b * intensity, color.a);
+}
 
-    boxMax.x = std::max(boxMax.x, triangle.p0.x);
-    boxMax.x = std::max(boxMax.x, triangle.p1.x);
-    boxMax.x = std::max(boxMax.x, triangle.p2.x);
+void drawTexturedModel(Model &model, const Texture &texture, const pipeline::Transform &transform, TGAImage &image, float *zbuffer) {
+    drawTexturedModel(model, texture, transform, image, zbuffer, Region::full(image.get_width(), image.get_height()));
+}
 
-    boxMax.y = std::max(boxMax.y, triangle.p0.y);
-    boxMax.y = std::max(boxMax.y, triangle.p1.y);
-    boxMax.y = std::max(boxMax.y, triangle.p2.y);
+void drawTexturedModel(Model &model, const Texture &texture, const pipeline::Transform &transform, TGAImage &image, float *zbuffer, const Region &region,
+                       const shadow::ShadowMap *shadows) {
+    const int width                = region.frameWidth;
+    const int height               = region.frameHeight;
+    const bool vertNormals         = model.has_normals();
+    const glm::vec3 lightDirection = shadows ? shadows->getDirection() : light_dir;
+    if (!pipeline::isVisible(model, transform, region)) {
+        return;
+    }
+    std::vector<glm::vec4> clip;
+    pipeline::transformVertices(model, transform.mvp(), clip);
+    const glm::mat4 normalMatrix = transform.normalMatrix();
+    visitImage(image, [&](auto view) {
+        for (int i = 0; i < model.nfaces(); i++) {
+            std::vector<int> face = model.face(i);
+            glm::vec4 clip_coords[3];
+            glm::vec3 world_coords[3];
+            objects::Varyings varyings;
+            for (int j = 0; j < 3; j++) {
+                clip_coords[j]     = clip[face[j]];
+                world_coords[j]    = glm::vec3(transform.model * glm::vec4(model.vert(face[j]), 1.f));
+                varyings.uv[j]     = model.uv(i, j);
+                varyings.normal[j] = glm::vec3(normalMatrix * glm::vec4(model.normal(i, j), 0.f));
+            }
 
-    // off by one could be a thing here
-    for (int i = boxMin.x; i < boxMax.x; i++) {
-        for (int j = boxMin.y; j < boxMax.y; j++) {
-            float u;
-            float v;
-            float w;
-            Barycentric({i, j}, triangle.p0, triangle.p1, triangle.p2, u, v, w);
-            if (u < 0 || v < 0 || w < 0)
+            glm::vec3 n          = glm::cross((world_coords[2] - world_coords[0]), (world_coords[1] - world_coords[0]));
+            float faceIntensity  = glm::dot(glm::normalize(n), lightDirection);
+            if (faceIntensity < 0 && !shadows) {
                 continue;
-            glm::vec3 zVal = triangle.p0 * u + triangle.p1 * v + triangle.p2 * w;
-            if (zbuffer[int(i + j * width)] < zVal[2]) {
-                zbuffer[int(i + j * width)] = zVal[2];
-                image.set(i, j, triangle.color);
             }
+
+            // one mip level per triangle keeps the lod math out of the pixel loop
+            float lod = 0.f;
+            if (clip_coords[0].w > 0.f && clip_coords[1].w > 0.f && clip_coords[2].w > 0.f) {
+                const glm::vec3 screen_coords[3] = {pipeline::toScreen(clip_coords[0], width, height), pipeline::toScreen(clip_coords[1], width, height),
+                                                    pipeline::toScreen(clip_coords[2], width, height)};
+                lod = texture.triangleLod(varyings.uv, screen_coords);
+            }
+
+            pipeline::drawTriangle(clip_coords, region, zbuffer, [&](int x, int y, glm::vec3 bary) {
+                glm::vec2 uv = varyings.uv[0] * bary.x + varyings.uv[1] * bary.y + varyings.uv[2] * bary.z;
+
+                float intensity = faceIntensity;
+                if (vertNormals) {
+                    glm::vec3 normal = varyings.normal[0] * bary.x + varyings.normal[1] * bary.y + varyings.normal[2] * bary.z;
+                    intensity        = glm::dot(glm::normalize(normal), -lightDirection);
+                }
+                if (shadows) {
+                    const glm::vec3 world = world_coords[0] * bary.x + world_coords[1] * bary.y + world_coords[2] * bary.z;
+                    intensity             = shadow::shade(intensity, shadows->visibility(world, intensity));
+                }
+                view.set(x, y, shade(texture.sample(uv, lod), intensity));
+            });
         }
-    }
+    });
+}
+
+void drawTriangle(const objects::Triangle &triangle, TGAImage &image, float *zbuffer) {
+    // drawLine({triangle.p0, triangle.p1, triangle.color}, image);
+    // drawLine({triangle.p1, triangle.p2, triangle.color}, image);
+    // drawLine({triangle.p2, triangle.p0, triangle.color}, image);
+
+    visitImage(image, [&](auto view) { rasterizeTriangle(triangle, view.getWidth(), view.getHeight(), zbuffer, [&](int x, int y, glm::vec3) { view.set(x, y, triangle.color); }); });
 }
 
 }   // namespace drawing
\ No newline at end of file
@@ -1,9 +1,15 @@
 #pragma once
 
+#include "line.hpp"
 #include "model.hpp"
 #include "objects.hpp"
+#include "pipeline.hpp"
+#include "raster.hpp"
+#include "shadow.hpp"
+#include "texture.hpp"
 #include "tgaimage.hpp"
 #include <glm/fwd.hpp>
+#include <glm/glm.hpp>
 #include <vector>
 
 namespace drawing {
@@ -11,8 +17,28 @@ namespace drawing {
 void drawLine(int x0, int y0, int x1, int y1, TGAImage &image, TGAColor color);
 void drawLine(const objects::Line line,TGAImage &image ); // this calls the drawline function above
 
-void drawModel(Model &model, TGAImage &image, float* zbuffer);
+// Draws every unique edge once, clipped and in parallel over screen bands
+void drawModelWireFrame(Model &model, const pipeline::Transform &transform, TGAImage &image, bool antialiased = false);
+void drawModel(Model &model, const pipeline::Transform &transform, TGAImage &image, float* zbuffer);
+
+// The light of drawModel, it sits at the camera
+extern glm::vec3 light_dir;
+TGAColor randomColor(float intensity);
+// Flat shading of drawModel: cosine between the face normal and the light from the world space corners, negative on back faces
+float faceIntensity(const glm::vec3 world[3], glm::vec3 lightDirection = light_dir);
+// One face of drawModel, clip holds the clip space positions of the model vertices
+void drawFlatFace(Model &model, int face, const glm::vec4 *clip, const glm::mat4 &modelMatrix, TGAImage &image, float *zbuffer);
+void drawTexturedModel(Model &model, const Texture &texture, const pipeline::Transform &transform, TGAImage &image, float *zbuffer);
+
+// Crop window versions: image and zbuffer cover only the region of the frame.
+// With a shadow map, faces are lit by its light and every pixel is attenuated by its shadow lookup.
+void drawModelWireFrame(Model &model, const pipeline::Transform &transform, TGAImage &image, const Region &region, bool antialiased = false);
+void drawModel(Model &model, const pipeline::Transform &transform, TGAImage &image, float *zbuffer, const Region &region, const shadow::ShadowMap *shadows = nullptr);
+void drawFlatFace(Model &model, int face, const glm::vec4 *clip, const glm::mat4 &modelMatrix, TGAImage &image, float *zbuffer, const Region &region,
+                  const shadow::ShadowMap *shadows = nullptr);
+void drawTexturedModel(Model &model, const Texture &texture, const pipeline::Transform &transform, TGAImage &image, float *zbuffer, const Region &region,
+                       const shadow::ShadowMap *shadows = nullptr);
 
 void drawTriangle(const objects::Triangle &triangle, TGAImage &image, float* zbuffer);
 
-}   // namespace drawing
\ No newline at end of file
+}   // namespace drawing
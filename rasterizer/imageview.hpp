@@ -0,0 +1,80 @@
+#pragma once
+
+#include "tgaimage.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+
+static_assert(sizeof(TGAColor) == 4, "TGAColor is stored and copied as one 32 bit word");
+
+/**
+ * Unchecked access to the pixels of a TGAImage whose format is fixed at compile time.
+ * Rows are contiguous, every pixel is Bytespp bytes in b, g, r, a order.
+ * The caller keeps coordinates inside the image.
+ */
+template <int Bytespp> class ImageView {
+  public:
+    static const int bytespp = Bytespp;
+
+    explicit ImageView(TGAImage &image) : data{image.buffer()}, width{image.get_width()}, height{image.get_height()} { assert(image.get_bytespp() == Bytespp); }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    unsigned char *row(int y) const { return data + (size_t) y * width * Bytespp; }
+
+    static void store(unsigned char *p, TGAColor c) {
+        if constexpr (Bytespp == TGAImage::RGBA) {
+            memcpy(p, c.raw, 4);
+        } else if constexpr (Bytespp == TGAImage::RGB) {
+            p[0] = c.b;
+            p[1] = c.g;
+            p[2] = c.r;
+        } else {
+            p[0] = c.raw[0];
+        }
+    }
+
+    static TGAColor load(const unsigned char *p) {
+        TGAColor c;
+        memcpy(c.raw, p, Bytespp);
+        return c;
+    }
+
+    void set(int x, int y, TGAColor c) const { store(row(y) + (size_t) x * Bytespp, c); }
+    TGAColor get(int x, int y) const { return load(row(y) + (size_t) x * Bytespp); }
+
+    // count pixels of row y starting at x
+    void fill(int x, int y, int count, TGAColor c) const {
+        unsigned char *p = row(y) + (size_t) x * Bytespp;
+        for (int i = 0; i < count; i++, p += Bytespp) {
+            store(p, c);
+        }
+    }
+
+  private:
+    unsigned char *data;
+    int width;
+    int height;
+};
+
+using GrayscaleView = ImageView<TGAImage::GRAYSCALE>;
+using RGBView       = ImageView<TGAImage::RGB>;
+using RGBAView      = ImageView<TGAImage::RGBA>;
+
+/**
+ * Calls f with the view matching the format of the image, so f is compiled once per format
+ * @return false if the image has no pixels
+ */
+template <typename F> bool visitImage(TGAImage &image, F &&f) {
+    if (!image.buffer()) {
+        return false;
+    }
+    switch (image.get_bytespp()) {
+        case TGAImage::GRAYSCALE: f(GrayscaleView{image}); return true;
+        case TGAImage::RGB: f(RGBView{image}); return true;
+        case TGAImage::RGBA: f(RGBAView{image}); return true;
+        default: return false;
+    }
+}
@@ -0,0 +1,213 @@
+#include "line.hpp"
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+enum OutCode { INSIDE = 0, LEFT = 1, RIGHT = 2, BOTTOM = 4, TOP = 8 };
+
+int outCode(glm::vec2 p, glm::vec2 min, glm::vec2 max) {
+    int code = INSIDE;
+    if (p.x < min.x) {
+        code |= LEFT;
+    } else if (p.x > max.x) {
+        code |= RIGHT;
+    }
+    if (p.y < min.y) {
+        code |= BOTTOM;
+    } else if (p.y > max.y) {
+        code |= TOP;
+    }
+    return code;
+}
+
+inline void fillSpan(unsigned char *dst, int count, const TGAColor &color, int bytespp) {
+    if (bytespp == 4) {
+        for (int i = 0; i < count; i++, dst += 4) {
+            memcpy(dst, color.raw, 4);
+        }
+    } else if (bytespp == 1) {
+        memset(dst, color.raw[0], count);
+    } else {
+        for (int i = 0; i < count; i++, dst += bytespp) {
+            memcpy(dst, color.raw, bytespp);
+        }
+    }
+}
+
+inline void blend(unsigned char *dst, const TGAColor &color, int bytespp, float coverage) {
+    for (int c = 0; c < bytespp; c++) {
+        dst[c] = (unsigned char) (dst[c] + (color.raw[c] - dst[c]) * coverage + .5f);
+    }
+}
+
+// Whether a segment between rows y0 and y1 can touch the band, margin covers rounding and wide kernels
+bool bandOverlap(float y0, float y1, const drawing::LineTarget &target, int margin) {
+    return std::max(y0, y1) + margin >= target.rowBegin && std::min(y0, y1) - margin < target.rowEnd;
+}
+
+}   // namespace
+
+namespace drawing {
+
+bool clipLine(glm::vec2 &p0, glm::vec2 &p1, glm::vec2 min, glm::vec2 max) {
+    int code0 = outCode(p0, min, max);
+    int code1 = outCode(p1, min, max);
+    while (true) {
+        if (!(code0 | code1)) {
+            return true;
+        }
+        if (code0 & code1) {
+            return false;
+        }
+        // move the outside endpoint onto the boundary it crosses
+        const int code = code0 ? code0 : code1;
+        glm::vec2 p;
+        if (code & TOP) {
+            p = {p0.x + (p1.x - p0.x) * (max.y - p0.y) / (p1.y - p0.y), max.y};
+        } else if (code & BOTTOM) {
+            p = {p0.x + (p1.x - p0.x) * (min.y - p0.y) / (p1.y - p0.y), min.y};
+        } else if (code & RIGHT) {
+            p = {max.x, p0.y + (p1.y - p0.y) * (max.x - p0.x) / (p1.x - p0.x)};
+        } else {
+            p = {min.x, p0.y + (p1.y - p0.y) * (min.x - p0.x) / (p1.x - p0.x)};
+        }
+        if (code == code0) {
+            p0    = p;
+            code0 = outCode(p0, min, max);
+        } else {
+            p1    = p;
+            code1 = outCode(p1, min, max);
+        }
+    }
+}
+
+void drawLineSpans(glm::vec2 p0, glm::vec2 p1, const LineTarget &target, TGAColor color) {
+    if (!bandOverlap(p0.y, p1.y, target, 1)) {
+        return;
+    }
+    const int columnEnd = target.originX + target.columns;
+    if (std::abs(p1.y - p0.y) > std::abs(p1.x - p0.x)) {
+        // steep: one pixel per row
+        if (p1.y < p0.y) {
+            std::swap(p0, p1);
+        }
+        const float slope = (p1.x - p0.x) / (p1.y - p0.y);
+        const int begin   = std::max((int) std::lround(p0.y), target.rowBegin);
+        const int end     = std::min((int) std::lround(p1.y) + 1, target.rowEnd);
+        for (int y = begin; y < end; y++) {
+            const int x = std::min(target.width - 1, std::max(0, (int) std::lround(p0.x + (y - p0.y) * slope)));
+            if (x >= target.originX && x < columnEnd) {
+                memcpy(target.pixel(x, y), color.raw, target.bytespp);
+            }
+        }
+        return;
+    }
+
+    // shallow: the pixels of a row form one run
+    if (p1.x < p0.x) {
+        std::swap(p0, p1);
+    }
+    const int x0      = (int) std::lround(p0.x);
+    const int x1      = (int) std::lround(p1.x);
+    const float slope = x1 > x0 ? (p1.y - p0.y) / (p1.x - p0.x) : 0.f;
+    auto row          = [&](int x) { return std::min(target.height - 1, std::max(0, (int) std::lround(p0.y + (x - p0.x) * slope))); };
+
+    int runStart = x0;
+    int runRow   = row(x0);
+    for (int x = x0 + 1; x <= x1 + 1; x++) {
+        const int y = x <= x1 ? row(x) : -1;
+        if (y == runRow) {
+            continue;
+        }
+        const int begin = std::max(runStart, target.originX);
+        const int end   = std::min(x, columnEnd);
+        if (runRow >= target.rowBegin && runRow < target.rowEnd && begin < end) {
+            fillSpan(target.pixel(begin, runRow), end - begin, color, target.bytespp);
+        }
+        runStart = x;
+        runRow   = y;
+    }
+}
+
+void drawLineWu(glm::vec2 p0, glm::vec2 p1, const LineTarget &target, TGAColor color) {
+    if (!bandOverlap(p0.y, p1.y, target, 2)) {
+        return;
+    }
+    const bool steep = std::abs(p1.y - p0.y) > std::abs(p1.x - p0.x);
+    if (steep) {
+        std::swap(p0.x, p0.y);
+        std::swap(p1.x, p1.y);
+    }
+    if (p1.x < p0.x) {
+        std::swap(p0, p1);
+    }
+    const float gradient = p1.x > p0.x ? (p1.y - p0.y) / (p1.x - p0.x) : 0.f;
+    auto plot            = [&](int x, int y, float coverage) {
+        if (steep) {
+            std::swap(x, y);
+        }
+        if (y < target.rowBegin || y >= target.rowEnd || x < target.originX || x >= target.originX + target.columns || coverage <= 0.f) {
+            return;
+        }
+        blend(target.pixel(x, y), color, target.bytespp, coverage);
+    };
+
+    const int x0 = (int) std::lround(p0.x);
+    const int x1 = (int) std::lround(p1.x);
+    for (int x = x0; x <= x1; x++) {
+        const float y  = p0.y + (x - p0.x) * gradient;
+        const float fy = std::floor(y);
+        plot(x, (int) fy, 1.f - (y - fy));
+        plot(x, (int) fy + 1, y - fy);
+    }
+}
+
+void drawLines(const std::vector<glm::vec2> &segments, TGAImage &image, TGAColor color, bool antialiased) {
+    drawLines(segments, image, color, Region::full(image.get_width(), image.get_height()), antialiased);
+}
+
+void drawLines(const std::vector<glm::vec2> &segments, TGAImage &image, TGAColor color, const Region &region, bool antialiased) {
+    const int width     = region.frameWidth;
+    const int height    = region.frameHeight;
+    const int bytespp   = image.get_bytespp();
+    unsigned char *data = image.buffer();
+    if (!data) {
+        return;
+    }
+
+    std::vector<glm::vec2> clipped;
+    clipped.reserve(segments.size());
+    const glm::vec2 min{0.f, 0.f};
+    const glm::vec2 max{width - 1.f, height - 1.f};
+    for (size_t i = 0; i + 1 < segments.size(); i += 2) {
+        glm::vec2 p0 = segments[i];
+        glm::vec2 p1 = segments[i + 1];
+        if (clipLine(p0, p1, min, max)) {
+            clipped.push_back(p0);
+            clipped.push_back(p1);
+        }
+    }
+
+    // segments are clipped to the frame like in a full render, so every pixel of the region gets its full frame value.
+    // Every thread owns a band of rows, no two threads write the same pixel.
+    parallel::forRows(
+        region.height,
+        [&](int begin, int end) {
+            const LineTarget target{data, width, height, bytespp, region.y + begin, region.y + end, region.x, region.y, region.width};
+            for (size_t i = 0; i < clipped.size(); i += 2) {
+                if (antialiased) {
+                    drawLineWu(clipped[i], clipped[i + 1], target, color);
+                } else {
+                    drawLineSpans(clipped[i], clipped[i + 1], target, color);
+                }
+            }
+        },
+        64);
+}
+
+}   // namespace drawing
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "raster.hpp"
+#include "tgaimage.hpp"
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace drawing {
+
+/**
+ * Cohen-Sutherland clipping of a segment to the rectangle [min, max]
+ * @return false if no part of the segment is inside
+ */
+bool clipLine(glm::vec2 &p0, glm::vec2 &p1, glm::vec2 min, glm::vec2 max);
+
+/**
+ * Rows [rowBegin, rowEnd) of an image that a line kernel may write to.
+ * Coordinates are frame pixels, the image holds the columns [originX, originX + columns) of the rows from originY on.
+ */
+struct LineTarget {
+    unsigned char *data;
+    int width;   // of the frame, lines are clamped to it
+    int height;
+    int bytespp;
+    int rowBegin;
+    int rowEnd;
+    int originX;
+    int originY;
+    int columns;
+
+    unsigned char *pixel(int x, int y) const { return data + ((size_t) (y - originY) * columns + x - originX) * bytespp; }
+};
+
+/**
+ * Draws a segment that lies inside the image as horizontal runs of pixels written straight into the buffer.
+ * Pixels are a function of the column (or row) alone, so a segment drawn into several row bands
+ * gives exactly the pixels of drawing it at once.
+ */
+void drawLineSpans(glm::vec2 p0, glm::vec2 p1, const LineTarget &target, TGAColor color);
+
+/**
+ * Xiaolin Wu anti-aliased segment, blends color into the two pixels nearest to the line by coverage
+ */
+void drawLineWu(glm::vec2 p0, glm::vec2 p1, const LineTarget &target, TGAColor color);
+
+/**
+ * Clips and draws segments (pairs of points in pixel coordinates) in parallel over disjoint row bands
+ * @param antialiased use drawLineWu instead of drawLineSpans
+ */
+void drawLines(const std::vector<glm::vec2> &segments, TGAImage &image, TGAColor color, bool antialiased = false);
+
+/**
+ * drawLines into a crop window: segments are in frame pixels, the image holds the region
+ */
+void drawLines(const std::vector<glm::vec2> &segments, TGAImage &image, TGAColor color, const Region &region, bool antialiased = false);
+
+}   // namespace drawing
@@ -0,0 +1,408 @@
+#include "lod.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <queue>
+#include <utility>
+
+namespace {
+
+// Symmetric 4x4 matrix: aa ab ac ad bb bc bd cc cd dd
+struct Quadric {
+    double q[10]{};
+
+    static Quadric plane(glm::vec3 n, float d, double weight) {
+        Quadric r;
+        const double p[4] = {n.x, n.y, n.z, d};
+        int k             = 0;
+        for (int i = 0; i < 4; i++) {
+            for (int j = i; j < 4; j++) {
+                r.q[k++] = weight * p[i] * p[j];
+            }
+        }
+        return r;
+    }
+
+    Quadric &operator+=(const Quadric &o) {
+        for (int i = 0; i < 10; i++) {
+            q[i] += o.q[i];
+        }
+        return *this;
+    }
+
+    double evaluate(glm::vec3 v) const {
+        const double x = v.x, y = v.y, z = v.z;
+        return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y + q[7] * z * z + 2 * q[8] * z + q[9];
+    }
+
+    // Position with the smallest error, false if the system is (nearly) singular
+    bool optimum(glm::vec3 &v) const {
+        const double a = q[0], b = q[1], c = q[2], d = q[4], e = q[5], f = q[7];
+        const double det = a * (d * f - e * e) - b * (b * f - e * c) + c * (b * e - d * c);
+        if (std::abs(det) < 1e-12) {
+            return false;
+        }
+        const double r0 = -q[3], r1 = -q[6], r2 = -q[8];
+        // Cramer's rule
+        v.x = (r0 * (d * f - e * e) - b * (r1 * f - e * r2) + c * (r1 * e - d * r2)) / det;
+        v.y = (a * (r1 * f - e * r2) - r0 * (b * f - e * c) + c * (b * r2 - r1 * c)) / det;
+        v.z = (a * (d * r2 - r1 * e) - b * (b * r2 - r1 * c) + r0 * (b * e - d * c)) / det;
+        return true;
+    }
+};
+
+struct Collapse {
+    double cost;
+    int a;
+    int b;
+    int stampA;
+    int stampB;
+    glm::vec3 position;
+
+    bool operator>(const Collapse &o) const { return cost > o.cost; }
+};
+
+// Weight of the planes that keep open boundaries in place
+const double BOUNDARY_WEIGHT = 1000.;
+
+// Closest point to p on the triangle a b c (Ericson, Real-Time Collision Detection 5.1.5)
+glm::vec3 closestPoint(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+    const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f) {
+        return a;
+    }
+    const glm::vec3 bp = p - b;
+    const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3) {
+        return b;
+    }
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+    const glm::vec3 cp = p - c;
+    const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6) {
+        return c;
+    }
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    const float denominator = 1.f / (va + vb + vc);
+    return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+}   // namespace
+
+namespace lod {
+
+Model simplify(Model &model, int targetFaces, float &error) {
+    error = 0.f;
+    std::vector<glm::vec3> pos(model.nverts());
+    for (int i = 0; i < model.nverts(); i++) {
+        pos[i] = model.vert(i);
+    }
+    std::vector<std::array<glm::ivec3, 3>> faces(model.nfaces());
+    std::vector<bool> faceAlive(model.nfaces(), true);
+    std::vector<std::vector<int>> adjacency(pos.size());
+    for (int f = 0; f < model.nfaces(); f++) {
+        for (int j = 0; j < 3; j++) {
+            faces[f][j] = model.corner(f, j);
+            adjacency[faces[f][j][0]].push_back(f);
+        }
+    }
+
+    // plane quadrics of the faces, area weighted
+    std::vector<Quadric> quadrics(pos.size());
+    std::map<std::pair<int, int>, std::pair<int, int>> edges;   // edge -> (face count, last face)
+    for (int f = 0; f < (int) faces.size(); f++) {
+        const glm::vec3 &p0 = pos[faces[f][0][0]], &p1 = pos[faces[f][1][0]], &p2 = pos[faces[f][2][0]];
+        glm::vec3 n        = glm::cross(p1 - p0, p2 - p0);
+        const float area   = glm::length(n);
+        if (area <= 0.f) {
+            continue;
+        }
+        n /= area;
+        const Quadric q = Quadric::plane(n, -glm::dot(n, p0), area * .5f);
+        for (int j = 0; j < 3; j++) {
+            quadrics[faces[f][j][0]] += q;
+            const int a = faces[f][j][0], b = faces[f][(j + 1) % 3][0];
+            auto &edge  = edges[{std::min(a, b), std::max(a, b)}];
+            edge.first++;
+            edge.second = f;
+        }
+    }
+    for (const auto &edge : edges) {
+        if (edge.second.first != 1) {
+            continue;
+        }
+        const int a = edge.first.first, b = edge.first.second;
+        const std::array<glm::ivec3, 3> &face = faces[edge.second.second];
+        const glm::vec3 faceNormal = glm::cross(pos[face[1][0]] - pos[face[0][0]], pos[face[2][0]] - pos[face[0][0]]);
+        glm::vec3 n                = glm::cross(pos[b] - pos[a], faceNormal);
+        if (glm::length(n) <= 0.f) {
+            continue;
+        }
+        n               = glm::normalize(n);
+        const Quadric q = Quadric::plane(n, -glm::dot(n, pos[a]), BOUNDARY_WEIGHT * glm::length(pos[b] - pos[a]));
+        quadrics[a] += q;
+        quadrics[b] += q;
+    }
+
+    // what every vertex stands for: the input vertices merged into it and the input faces around those
+    const std::vector<glm::vec3> original                      = pos;
+    const std::vector<std::array<glm::ivec3, 3>> originalFaces = faces;
+    const std::vector<std::vector<int>> originalAdjacency      = adjacency;
+    std::vector<std::vector<int>> mergedFaces                  = adjacency;
+    std::vector<std::vector<int>> mergedVerts(pos.size());
+    for (int v = 0; v < (int) pos.size(); v++) {
+        mergedVerts[v] = {v};
+    }
+
+    std::vector<int> stamp(pos.size(), 0);
+    std::vector<bool> vertAlive(pos.size(), true);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+    auto pushEdge = [&](int a, int b) {
+        Quadric q = quadrics[a];
+        q += quadrics[b];
+        glm::vec3 best;
+        if (!q.optimum(best)) {
+            best = (pos[a] + pos[b]) * .5f;
+        }
+        // never move further than the edge itself, an optimum far away means a flat region
+        const glm::vec3 candidates[4] = {best, pos[a], pos[b], (pos[a] + pos[b]) * .5f};
+        double cost                   = std::numeric_limits<double>::max();
+        for (int i = 0; i < 4; i++) {
+            if (i == 0 && glm::length(best - (pos[a] + pos[b]) * .5f) > glm::length(pos[b] - pos[a])) {
+                continue;
+            }
+            const double c = q.evaluate(candidates[i]);
+            if (c < cost) {
+                cost = c;
+                best = candidates[i];
+            }
+        }
+        heap.push({std::max(0., cost), a, b, stamp[a], stamp[b], best});
+    };
+    for (const auto &edge : edges) {
+        pushEdge(edge.first.first, edge.first.second);
+    }
+
+    // would moving vertex v to p turn any of its faces (other than the collapsing ones) over
+    auto flips = [&](int v, int other, glm::vec3 p) {
+        for (int f : adjacency[v]) {
+            if (!faceAlive[f]) {
+                continue;
+            }
+            glm::vec3 before[3];
+            glm::vec3 after[3];
+            bool collapsing = false;
+            for (int j = 0; j < 3; j++) {
+                const int idx = faces[f][j][0];
+                collapsing |= idx == other;
+                before[j] = pos[idx];
+                after[j]  = idx == v ? p : pos[idx];
+            }
+            if (collapsing) {
+                continue;
+            }
+            const glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+            const glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(n0, n1) <= 0.f) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    int liveFaces = (int) faces.size();
+    while (liveFaces > targetFaces && !heap.empty()) {
+        const Collapse c = heap.top();
+        heap.pop();
+        if (!vertAlive[c.a] || !vertAlive[c.b] || stamp[c.a] != c.stampA || stamp[c.b] != c.stampB) {
+            continue;
+        }
+        if (flips(c.a, c.b, c.position) || flips(c.b, c.a, c.position)) {
+            continue;
+        }
+
+        // b goes into a
+        pos[c.a] = c.position;
+        quadrics[c.a] += quadrics[c.b];
+        vertAlive[c.b] = false;
+        stamp[c.a]++;
+        stamp[c.b]++;
+        for (int f : adjacency[c.b]) {
+            if (!faceAlive[f]) {
+                continue;
+            }
+            bool hasA = false;
+            for (int j = 0; j < 3; j++) {
+                hasA |= faces[f][j][0] == c.a;
+            }
+            if (hasA) {
+                faceAlive[f] = false;
+                liveFaces--;
+                continue;
+            }
+            for (int j = 0; j < 3; j++) {
+                if (faces[f][j][0] == c.b) {
+                    faces[f][j][0] = c.a;
+                }
+            }
+            adjacency[c.a].push_back(f);
+        }
+        adjacency[c.b].clear();
+
+        std::vector<int> &around = adjacency[c.a];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](int f) { return !faceAlive[f]; }), around.end());
+        std::sort(around.begin(), around.end());
+        around.erase(std::unique(around.begin(), around.end()), around.end());
+
+        std::vector<int> neighbours;
+        for (int f : around) {
+            for (int j = 0; j < 3; j++) {
+                if (faces[f][j][0] != c.a) {
+                    neighbours.push_back(faces[f][j][0]);
+                }
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        for (int n : neighbours) {
+            stamp[n]++;
+        }
+        // the stamps of a and its neighbours changed, which invalidates every edge that touches them
+        std::vector<std::pair<int, int>> stale;
+        for (int n : neighbours) {
+            for (int f : adjacency[n]) {
+                if (!faceAlive[f]) {
+                    continue;
+                }
+                for (int j = 0; j < 3; j++) {
+                    const int m = faces[f][j][0];
+                    if (m != n) {
+                        stale.push_back({std::min(m, n), std::max(m, n)});
+                    }
+                }
+            }
+        }
+        std::sort(stale.begin(), stale.end());
+        stale.erase(std::unique(stale.begin(), stale.end()), stale.end());
+        for (const std::pair<int, int> &edge : stale) {
+            pushEdge(edge.first, edge.second);
+        }
+
+        mergedVerts[c.a].insert(mergedVerts[c.a].end(), mergedVerts[c.b].begin(), mergedVerts[c.b].end());
+        mergedFaces[c.a].insert(mergedFaces[c.a].end(), mergedFaces[c.b].begin(), mergedFaces[c.b].end());
+        mergedVerts[c.b].clear();
+        mergedFaces[c.b].clear();
+    }
+
+    // The quadric cost is area weighted and includes the boundary planes, it orders the collapses but isn't a distance.
+    // The error is measured both ways at the merged vertices: from the vertex to the input surface around what it
+    // replaced, and from each input vertex it stands for to the faces around it now. Vertices slide along the surface
+    // up to an edge length, so both searches reach one ring of faces further.
+    auto distance = [](glm::vec3 p, const std::array<glm::ivec3, 3> &face, const std::vector<glm::vec3> &points) {
+        return glm::length(p - closestPoint(p, points[face[0][0]], points[face[1][0]], points[face[2][0]]));
+    };
+    auto ring = [](const std::vector<int> &around, const std::vector<std::array<glm::ivec3, 3>> &faces, const std::vector<std::vector<int>> &adjacency) {
+        std::vector<int> wider;
+        for (int f : around) {
+            for (int j = 0; j < 3; j++) {
+                const std::vector<int> &next = adjacency[faces[f][j][0]];
+                wider.insert(wider.end(), next.begin(), next.end());
+            }
+        }
+        std::sort(wider.begin(), wider.end());
+        wider.erase(std::unique(wider.begin(), wider.end()), wider.end());
+        return wider;
+    };
+    for (int v = 0; v < (int) pos.size(); v++) {
+        if (!vertAlive[v] || mergedVerts[v].size() < 2) {
+            continue;
+        }
+        float nearest = std::numeric_limits<float>::max();
+        for (int f : ring(mergedFaces[v], originalFaces, originalAdjacency)) {
+            nearest = std::min(nearest, distance(pos[v], originalFaces[f], original));
+        }
+        error = std::max(error, nearest);
+
+        std::vector<int> around = ring(adjacency[v], faces, adjacency);
+        around.erase(std::remove_if(around.begin(), around.end(), [&](int f) { return !faceAlive[f]; }), around.end());
+        if (around.empty()) {
+            continue;
+        }
+        for (int o : mergedVerts[v]) {
+            nearest = std::numeric_limits<float>::max();
+            for (int f : around) {
+                nearest = std::min(nearest, distance(original[o], faces[f], pos));
+            }
+            error = std::max(error, nearest);
+        }
+    }
+
+    // compact the surviving vertices
+    std::vector<int> remap(pos.size(), -1);
+    std::vector<glm::vec3> verts;
+    std::vector<std::vector<glm::ivec3>> outFaces;
+    for (int f = 0; f < (int) faces.size(); f++) {
+        if (!faceAlive[f]) {
+            continue;
+        }
+        std::vector<glm::ivec3> face;
+        for (int j = 0; j < 3; j++) {
+            glm::ivec3 corner = faces[f][j];
+            if (remap[corner[0]] < 0) {
+                remap[corner[0]] = (int) verts.size();
+                verts.push_back(pos[corner[0]]);
+            }
+            corner[0] = remap[corner[0]];
+            face.push_back(corner);
+        }
+        outFaces.push_back(face);
+    }
+    return Model{verts, model.uvs(), model.normals(), outFaces};
+}
+
+LodChain::LodChain(Model &model, int levels, float ratio, int minFaces) : base{model} {
+    errors.push_back(0.f);
+    coarser.reserve(levels);
+    for (int i = 1; i < levels; i++) {
+        Model &previous  = level(i - 1);
+        const int target = (int) (previous.nfaces() * ratio);
+        if (target < minFaces) {
+            break;
+        }
+        float error;
+        coarser.push_back(simplify(previous, target, error));
+        // errors add up as every level is simplified from the one before
+        errors.push_back(errors.back() + error);
+    }
+}
+
+int LodChain::select(const pipeline::Transform &transform, int screenHeight, float maxPixelError) {
+    const float scale      = std::max({glm::length(glm::vec3(transform.model[0])), glm::length(glm::vec3(transform.model[1])), glm::length(glm::vec3(transform.model[2]))});
+    const glm::vec3 eye    = glm::vec3(glm::inverse(transform.view) * glm::vec4{0.f, 0.f, 0.f, 1.f});
+    const glm::vec3 center = glm::vec3(transform.model * glm::vec4(base.bounding_center(), 1.f));
+    const float distance   = std::max(1e-4f, glm::length(center - eye) - base.bounding_radius() * scale);
+    // projection[1][1] is the cotangent of half the vertical field of view
+    const float pixelsPerUnit = transform.projection[1][1] * screenHeight * .5f / distance;
+    for (int i = levelCount() - 1; i > 0; i--) {
+        if (errors[i] * scale * pixelsPerUnit <= maxPixelError) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+}   // namespace lod
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "model.hpp"
+#include "pipeline.hpp"
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace lod {
+
+/**
+ * Quadric error metric simplification (Garland & Heckbert) by edge collapses.
+ * Boundaries are held in place by constraint planes and collapses that would flip a face are refused.
+ * Faces keep the uv/normal indices of their corners.
+ * @param error set to the largest distance between the result and the model, measured from the vertices of each to the faces of the other
+ */
+Model simplify(Model &model, int targetFaces, float &error);
+
+/**
+ * Progressively simplified versions of a model with their geometric error
+ */
+class LodChain {
+  public:
+    /**
+     * @param ratio the face count of every level relative to the previous one
+     */
+    LodChain(Model &model, int levels = 4, float ratio = .5f, int minFaces = 64);
+
+    int levelCount() const { return 1 + (int) coarser.size(); }
+    Model &level(int i) { return i == 0 ? base : coarser[i - 1]; }
+    float error(int i) const { return errors[i]; }
+
+    /**
+     * Coarsest level whose error stays below maxPixelError when projected on the screen
+     */
+    int select(const pipeline::Transform &transform, int screenHeight, float maxPixelError = 1.f);
+
+  private:
+    Model &base;
+    std::vector<Model> coarser{};
+    std::vector<float> errors{};
+};
+
+}   // namespace lod
@@ -1,4 +1,6 @@
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <limits>
@@ -6,64 +8,83 @@
 
 #include <glm/glm.hpp>
 
+#include "camera.hpp"
+#include "cluster.hpp"
 #include "color.hpp"
+#include "deferred.hpp"
 #include "drawing.hpp"
+#include "lod.hpp"
 #include "model.hpp"
+#include "msaa.hpp"
+#include "output.hpp"
+#include "pipeline.hpp"
+#include "shadow.hpp"
+#include "stream.hpp"
+#include "texture.hpp"
 #include "tgaimage.hpp"
 
 
 
-/* Coordinate system:
- * The middle of the screen should be (0, 0)
- * X grows positivly to the right
- * Y grows negativly down
- * Z grows positivly in the direction through the screen
- */
-namespace rasterizer {
-
-class ViewPort {
-    // The viewport is relative to the camera
-    // Assume the center of the viewport is the position of the viewport
-  public:
-    ViewPort(){};
-    ~ViewPort(){};
-
-    float getZ() { return this->LEFT_DOWN_POS[2]; }
-    glm::vec3 getLDP() { return LEFT_DOWN_POS; }
-    glm::vec3 getRUP() { return RIGHT_UP_POS; }
-
-  private:
-    /* +--------RUP
-     * |         |
-     * LDP-------+
-     */
-    glm::vec3 LEFT_DOWN_POS{-.5f, .5f, 1.f};   // remember the Y axis grows downwards
-    glm::vec3 RIGHT_UP_POS{.5f, -.5f, 1.f};
-};
-
-class Camera {
-    // Assume the position of the camera is the point where we are looking from
-    // Assume we are looking towards the positive Z
-  public:
-    Camera(){};
-    ~Camera(){};
-
-    glm::vec3 getPosition() { return this->position; }
-
-  private:
-    glm::vec3 position{0.0f, 0.0f, 0.0f};
-};
-
-}   // namespace rasterizer
-
 int main(int argc, char **argv) {
     // Init
 
     int width  = 1080;
     int height = 1080;
 
-    TGAImage image(width, height, TGAImage::RGB);
-    Model model("obj/model.obj");
+    bool deferredShading = false;
+    bool clustered       = false;
+    bool levelOfDetail   = false;
+    bool streaming       = false;
+    int samples          = 0;
+    bool wireframe       = false;
+    bool antialiased     = false;
+    bool shadows         = false;
+    drawing::Region region = drawing::Region::full(width, height);
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--deferred")) {
+            deferredShading = true;
+        } else if (!strcmp(argv[i], "--clusters")) {
+            clustered = true;
+        } else if (!strcmp(argv[i], "--lod")) {
+            levelOfDetail = true;
+        } else if (!strcmp(argv[i], "--stream")) {
+            streaming = true;
+        } else if (!strcmp(argv[i], "--msaa")) {
+            if (i + 1 >= argc) {
+                std::cerr << "usage: --msaa samples" << std::endl;
+                return 1;
+            }
+            samples = atoi(argv[++i]);
+            if (samples != 1 && samples != 4 && samples != 8) {
+                std::cerr << "unsupported --msaa " << samples << ", use 1, 4 or 8" << std::endl;
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--wireframe")) {
+            wireframe = true;
+        } else if (!strcmp(argv[i], "--aa")) {
+            antialiased = true;
+        } else if (!strcmp(argv[i], "--shadows")) {
+            shadows = true;
+        } else if (!strcmp(argv[i], "--crop") && i + 4 < argc) {
+            region.x      = atoi(argv[++i]);
+            region.y      = atoi(argv[++i]);
+            region.width  = atoi(argv[++i]);
+            region.height = atoi(argv[++i]);
+        }
+    }
+    if (region.x < 0 || region.y < 0 || region.width <= 0 || region.height <= 0 || region.x + region.width > width || region.y + region.height > height) {
+        std::cerr << "crop window outside the frame" << std::endl;
+        return 1;
+    }
+    if (shadows && (deferredShading || clustered || levelOfDetail || streaming || samples > 1 || wireframe)) {
+        std::cerr << "--shadows only applies to the default renderer" << std::endl;
+        return 1;
+    }
+
+    // a crop window renders only its own pixels, with the values they have in the full frame
+    TGAImage image(region.width, region.height, TGAImage::RGB);
+    // the streaming path never loads the whole obj
+    Model model(streaming ? "" : "obj/model.obj");
 
     // drawing::drawModel(model, image);
 
@@ -76,15 +97,76 @@ int main(int argc, char **argv) {
     // drawing::drawTriangle(triangle2, image);
     // drawing::drawTriangle(triangle3, image);
 
-    float zbuffer[height*width];
-    for (int i=width*height; i--; zbuffer[i] = -std::numeric_limits<float>::max());
-
-    drawing::drawModel(model, image, zbuffer);
-
-
-    image.flip_vertically();
-    image.write_tga_file("out.tga");
-    return 0;
+    float zbuffer[region.height*region.width];
+    for (int i=region.width*region.height; i--; zbuffer[i] = -std::numeric_limits<float>::max());
+
+    rasterizer::Camera camera{};
+    rasterizer::ViewPort viewPort{};
+    pipeline::Transform transform{};
+    transform.view       = camera.view();
+    transform.projection = viewPort.projection(camera.getNear(), camera.getFar());
+
+    // a light from the upper left, the default light sits at the camera and its shadows would be hidden
+    shadow::ShadowMap shadowMap{};
+    if (shadows) {
+        shadowMap.update(model, transform.model, glm::vec3{1.f, -1.f, -1.f});
+    }
+
+    Texture texture;
+    if (deferredShading) {
+        deferred::GBuffer gbuffer{region.width, region.height};
+        deferred::drawModel(model, transform, gbuffer, 1, region);
+
+        const std::vector<deferred::Material> materials{{}, {glm::vec3{1.f}, .1f}};
+        const std::vector<deferred::DirectionalLight> lights{{glm::vec3{0.f, 0.f, -1.f}, glm::vec3{.8f}}, {glm::normalize(glm::vec3{-1.f, -1.f, -.5f}), glm::vec3{.3f, .25f, .2f}}};
+        deferred::shade(gbuffer, materials, lights, image);
+    } else if (clustered) {
+        // two frames of a still camera: the second one culls against the depth the first one left
+        cluster::ClusteredModel clusteredModel{model};
+        cluster::OcclusionBuffer previous{};
+        for (int frame = 0; frame < 2; frame++) {
+            if (frame > 0) {
+                previous = cluster::OcclusionBuffer{zbuffer, region.width, region.height};
+                image    = TGAImage(region.width, region.height, TGAImage::RGB);
+                for (int i = region.width * region.height; i--; zbuffer[i] = -std::numeric_limits<float>::max());
+            }
+            const cluster::CullStats stats = clusteredModel.draw(transform, previous, image, zbuffer, region);
+            std::cerr << "frame " << frame << " clusters: " << stats.clusters << " drawn: " << stats.drawn << " frustum culled: " << stats.frustumCulled
+                      << " backface culled: " << stats.backfaceCulled << " occluded: " << stats.occluded << std::endl;
+        }
+    } else if (wireframe) {
+        drawing::drawModelWireFrame(model, transform, image, region, antialiased);
+    } else if (samples > 1) {
+        msaa::Buffer buffer{region, samples};
+        msaa::drawModel(model, transform, buffer);
+        buffer.resolve(image);
+        std::cerr << "msaa x" << buffer.getSamples() << " expanded pixels: " << buffer.expandedPixels() << std::endl;
+    } else if (streaming) {
+        stream::ChunkedMesh mesh;
+        const bool cached = !stream::outdated("obj/model.chunks", "obj/model.obj") && mesh.open("obj/model.chunks");
+        if (!cached && !(stream::convertObj("obj/model.obj", "obj/model.chunks") && mesh.open("obj/model.chunks"))) {
+            std::cerr << "can't open obj/model.chunks" << std::endl;
+            return 1;
+        }
+        const stream::StreamStats stats = stream::draw(mesh, transform, image, zbuffer, region);
+        std::cerr << "chunks: " << stats.chunks << " culled: " << stats.culled << " faces: " << stats.faces << std::endl;
+    } else if (levelOfDetail) {
+        lod::LodChain chain{model};
+        const int level = chain.select(transform, height);
+        std::cerr << "lod level: " << level << " of " << chain.levelCount() << " faces: " << chain.level(level).nfaces() << " error: " << chain.error(level) << std::endl;
+        drawing::drawModel(chain.level(level), transform, image, zbuffer, region);
+    } else if (model.has_uvs() && texture.load("obj/model_diffuse.tga")) {
+        drawing::drawTexturedModel(model, texture, transform, image, zbuffer, region, shadows ? &shadowMap : nullptr);
+    } else {
+        drawing::drawModel(model, transform, image, zbuffer, region, shadows ? &shadowMap : nullptr);
+    }
+
+    // flipping and rle encoding happen on the writer thread
+    output::TGAWriter writer{};
+    writer.submit({std::move(image), "out.tga", true, true, region.x, region.y});
+    if (!writer.finish()) {
+        return 1;
+    }
 
     return 0;
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <fstream>
@@ -5,7 +6,7 @@
 #include <vector>
 #include "model.hpp"
 
-Model::Model(const char *filename) : verts_(), faces_() {
+Model::Model(const char *filename) : verts_(), uvs_(), norms_(), faces_(), center_(0.f), radius_(0.f) {
     std::ifstream in;
     in.open (filename, std::ifstream::in);
     if (in.fail()) return;
@@ -19,23 +20,58 @@ Model::Model(const char *filename) : verts_(), faces_() {
             glm::vec3 v {0.f}; 
             for (int i=0;i<3;i++) iss >> v[i]; 
             verts_.push_back(v);
+        } else if (!line.compare(0, 3, "vt ")) {
+            iss >> trash >> trash;
+            glm::vec2 uv {0.f};
+            for (int i=0;i<2;i++) iss >> uv[i];
+            uvs_.push_back(uv);
+        } else if (!line.compare(0, 3, "vn ")) {
+            iss >> trash >> trash;
+            glm::vec3 n {0.f};
+            for (int i=0;i<3;i++) iss >> n[i];
+            norms_.push_back(glm::normalize(n));
         } else if (!line.compare(0, 2, "f ")) {
-            std::vector<int> f;
-            int itrash, idx;
+            std::vector<glm::ivec3> f;
+            std::string vertex;
             iss >> trash;
-            while (iss >> idx >> trash >> itrash >> trash >> itrash) {
-                idx--; // in wavefront obj all indices start at 1, not zero
-                f.push_back(idx);
+            while (iss >> vertex) {
+                // v, v/vt, v//vn or v/vt/vn
+                glm::ivec3 idx {0, 0, 0};
+                std::istringstream viss(vertex);
+                for (int i=0; i<3 && viss.good(); i++) {
+                    if (viss.peek() != '/') viss >> idx[i];
+                    if (viss.peek() == '/') viss.get();
+                }
+                f.push_back(idx - glm::ivec3(1)); // in wavefront obj all indices start at 1, not zero
             }
             faces_.push_back(f);
         }
     }
-    std::cerr << "# v# " << verts_.size() << " f# "  << faces_.size() << std::endl;
+    compute_bounds();
+    std::cerr << "# v# " << verts_.size() << " vt# " << uvs_.size() << " vn# " << norms_.size() << " f# "  << faces_.size() << std::endl;
+}
+
+Model::Model(const std::vector<glm::vec3> &verts, const std::vector<glm::vec2> &uvs, const std::vector<glm::vec3> &norms, const std::vector<std::vector<glm::ivec3> > &faces)
+    : verts_(verts), uvs_(uvs), norms_(norms), faces_(faces), center_(0.f), radius_(0.f) {
+    compute_bounds();
 }
 
 Model::~Model() {
 }
 
+// bounding sphere around the center of the bounding box
+void Model::compute_bounds() {
+    if (verts_.empty()) return;
+    glm::vec3 lo = verts_[0], hi = verts_[0];
+    for (const glm::vec3 &v : verts_) {
+        lo = glm::min(lo, v);
+        hi = glm::max(hi, v);
+    }
+    center_ = (lo + hi) * .5f;
+    radius_ = 0.f;
+    for (const glm::vec3 &v : verts_) radius_ = std::max(radius_, glm::length(v - center_));
+}
+
 int Model::nverts() {
     return (int)verts_.size();
 }
@@ -45,7 +81,64 @@ int Model::nfaces() {
 }
 
 std::vector<int> Model::face(int idx) {
-    return faces_[idx];
+    std::vector<int> face;
+    for (const glm::ivec3 &v : faces_[idx]) face.push_back(v[0]);
+    return face;
+}
+
+std::vector<glm::ivec2> Model::edges() {
+    // pack both indices in one key so sorting brings the shared edges together
+    std::vector<unsigned long long> keys;
+    for (const std::vector<glm::ivec3> &f : faces_) {
+        for (size_t j = 0; j < f.size(); j++) {
+            unsigned int a = f[j][0], b = f[(j + 1) % f.size()][0];
+            if (a > b) std::swap(a, b);
+            keys.push_back((unsigned long long)a << 32 | b);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    std::vector<glm::ivec2> edges(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) edges[i] = glm::ivec2((int)(keys[i] >> 32), (int)(keys[i] & 0xffffffffu));
+    return edges;
+}
+
+bool Model::has_uvs() {
+    return !uvs_.empty();
+}
+
+bool Model::has_normals() {
+    return !norms_.empty();
+}
+
+glm::vec2 Model::uv(int iface, int nthvert) {
+    int idx = faces_[iface][nthvert][1];
+    return idx < 0 ? glm::vec2(0.f) : uvs_[idx];
+}
+
+glm::ivec3 Model::corner(int iface, int nthvert) {
+    return faces_[iface][nthvert];
+}
+
+const std::vector<glm::vec2> &Model::uvs() {
+    return uvs_;
+}
+
+const std::vector<glm::vec3> &Model::normals() {
+    return norms_;
+}
+
+glm::vec3 Model::bounding_center() {
+    return center_;
+}
+
+float Model::bounding_radius() {
+    return radius_;
+}
+
+glm::vec3 Model::normal(int iface, int nthvert) {
+    int idx = faces_[iface][nthvert][2];
+    return idx < 0 ? glm::vec3(0.f) : norms_[idx];
 }
 
 glm::vec3 Model::vert(int i) {
@@ -7,14 +7,30 @@
 class Model {
 private:
 	std::vector<glm::vec3> verts_;
-	std::vector<std::vector<int> > faces_;
+	std::vector<glm::vec2> uvs_;
+	std::vector<glm::vec3> norms_;
+	std::vector<std::vector<glm::ivec3> > faces_; // vertex/uv/normal indices, -1 when absent
+	glm::vec3 center_;
+	float radius_;
+	void compute_bounds();
 public:
 	Model(const char *filename);
+	Model(const std::vector<glm::vec3> &verts, const std::vector<glm::vec2> &uvs, const std::vector<glm::vec3> &norms, const std::vector<std::vector<glm::ivec3> > &faces);
 	~Model();
 	int nverts();
 	int nfaces();
 	glm::vec3 vert(int i);
 	std::vector<int> face(int idx);
+	std::vector<glm::ivec2> edges(); // every edge once, smaller vertex index first
+	bool has_uvs();
+	bool has_normals();
+	glm::vec2 uv(int iface, int nthvert);
+	glm::vec3 normal(int iface, int nthvert);
+	glm::ivec3 corner(int iface, int nthvert); // vertex/uv/normal indices
+	const std::vector<glm::vec2> &uvs();
+	const std::vector<glm::vec3> &normals();
+	glm::vec3 bounding_center();
+	float bounding_radius();
 };
 
 #endif //__MODEL_H__
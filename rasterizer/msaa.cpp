@@ -0,0 +1,152 @@
+#include "msaa.hpp"
+
+#include "drawing.hpp"
+#include "imageview.hpp"
+#include "parallel.hpp"
+
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Standard rotated grid patterns, in sixteenths of a pixel
+const glm::vec2 OFFSETS_4[4] = {{-2.f / 16, -6.f / 16}, {6.f / 16, -2.f / 16}, {-6.f / 16, 2.f / 16}, {2.f / 16, 6.f / 16}};
+const glm::vec2 OFFSETS_8[8] = {{1.f / 16, -3.f / 16}, {-1.f / 16, 3.f / 16}, {5.f / 16, 1.f / 16},  {-3.f / 16, -5.f / 16},
+                                {-5.f / 16, 5.f / 16}, {-7.f / 16, -1.f / 16}, {3.f / 16, 7.f / 16}, {7.f / 16, -7.f / 16}};
+
+const float FAR = -std::numeric_limits<float>::max();
+
+}   // namespace
+
+namespace msaa {
+
+Buffer::Buffer(int width, int height, int samples) : Buffer(drawing::Region::full(width, height), samples) {}
+
+Buffer::Buffer(const drawing::Region &region, int samples) : region{region}, width{region.width}, height{region.height}, samples{samples == 8 ? 8 : 4} {
+    pixels.resize((size_t) width * height);
+    clear();
+}
+
+const glm::vec2 *Buffer::offsets() const { return samples == 8 ? OFFSETS_8 : OFFSETS_4; }
+
+void Buffer::clear(TGAColor background) {
+    std::fill(pixels.begin(), pixels.end(), Pixel{background.val, FAR, 0.f, 0.f, -1});
+    sampleColors.clear();
+    sampleDepths.clear();
+    freeBlocks.clear();
+    expandedCount = 0;
+}
+
+int Buffer::expand(Pixel &pixel) {
+    int block;
+    if (!freeBlocks.empty()) {
+        block = freeBlocks.back();
+        freeBlocks.pop_back();
+    } else {
+        block = (int) sampleColors.size();
+        sampleColors.resize(sampleColors.size() + samples);
+        sampleDepths.resize(sampleDepths.size() + samples);
+    }
+    const glm::vec2 *offs = offsets();
+    for (int s = 0; s < samples; s++) {
+        sampleColors[block + s] = pixel.color;
+        sampleDepths[block + s] = pixel.z + pixel.dzdx * offs[s].x + pixel.dzdy * offs[s].y;
+    }
+    pixel.block = block;
+    expandedCount++;
+    return block;
+}
+
+void Buffer::write(int x, int y, uint32_t coverage, float z, float dzdx, float dzdy, TGAColor color) {
+    Pixel &pixel          = pixels[(size_t) y * width + x];
+    const glm::vec2 *offs = offsets();
+    const uint32_t packed = color.val;
+
+    uint32_t passed = 0;
+    for (int s = 0; s < samples; s++) {
+        if (!(coverage & (1u << s))) {
+            continue;
+        }
+        const float depth  = z + dzdx * offs[s].x + dzdy * offs[s].y;
+        const float stored = pixel.block < 0 ? pixel.z + pixel.dzdx * offs[s].x + pixel.dzdy * offs[s].y : sampleDepths[pixel.block + s];
+        if (stored < depth) {
+            passed |= 1u << s;
+        }
+    }
+    if (!passed) {
+        return;
+    }
+
+    // the whole pixel now belongs to this triangle, store it compressed again
+    if (passed == fullMask()) {
+        if (pixel.block >= 0) {
+            freeBlocks.push_back(pixel.block);
+            expandedCount--;
+        }
+        pixel = Pixel{packed, z, dzdx, dzdy, -1};
+        return;
+    }
+
+    const int block = pixel.block < 0 ? expand(pixel) : pixel.block;
+    for (int s = 0; s < samples; s++) {
+        if (passed & (1u << s)) {
+            sampleColors[block + s] = packed;
+            sampleDepths[block + s] = z + dzdx * offs[s].x + dzdy * offs[s].y;
+        }
+    }
+}
+
+void Buffer::resolve(TGAImage &image) const {
+    visitImage(image, [&](auto view) {
+        const int w = std::min(width, view.getWidth());
+        parallel::forRows(std::min(height, view.getHeight()), [&](int begin, int end) {
+            for (int y = begin; y < end; y++) {
+                unsigned char *out = view.row(y);
+                for (int x = 0; x < w; x++, out += view.bytespp) {
+                    const Pixel &pixel = pixels[(size_t) y * width + x];
+                    TGAColor color{};
+                    color.val = pixel.color;
+                    if (pixel.block >= 0) {
+                        uint32_t sum[4] = {0, 0, 0, 0};
+                        for (int s = 0; s < samples; s++) {
+                            TGAColor c{};
+                            c.val = sampleColors[pixel.block + s];
+                            for (int k = 0; k < 4; k++) {
+                                sum[k] += c.raw[k];
+                            }
+                        }
+                        for (int k = 0; k < 4; k++) {
+                            color.raw[k] = (unsigned char) ((sum[k] + samples / 2) / samples);
+                        }
+                    }
+                    view.store(out, color);
+                }
+            }
+        });
+    });
+}
+
+void drawModel(Model &model, const pipeline::Transform &transform, Buffer &buffer) {
+    if (!pipeline::isVisible(model, transform, buffer.getRegion())) {
+        return;
+    }
+    std::vector<glm::vec4> clip;
+    pipeline::transformVertices(model, transform.mvp(), clip);
+    for (int i = 0; i < model.nfaces(); i++) {
+        const std::vector<int> verts = model.face(i);
+        glm::vec4 clipCoords[3];
+        glm::vec3 worldCoords[3];
+        for (int j = 0; j < 3; j++) {
+            clipCoords[j]  = clip[verts[j]];
+            worldCoords[j] = glm::vec3(transform.model * glm::vec4(model.vert(verts[j]), 1.f));
+        }
+        const float intensity = drawing::faceIntensity(worldCoords);
+        if (intensity < 0) {
+            continue;
+        }
+        const TGAColor color = drawing::randomColor(intensity);
+        drawTriangle(clipCoords, buffer, [&](glm::vec3) { return color; });
+    }
+}
+
+}   // namespace msaa
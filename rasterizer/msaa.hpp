@@ -0,0 +1,162 @@
+#pragma once
+
+#include "model.hpp"
+#include "pipeline.hpp"
+#include "raster.hpp"
+#include "tgaimage.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace msaa {
+
+/**
+ * Multisampled color and depth with 4 or 8 samples per pixel.
+ * A pixel whose samples all belong to one triangle is stored compressed: one color and the
+ * depth plane of the triangle. Only pixels on triangle edges expand to a color and depth per sample,
+ * so memory and resolve cost follow the number of edge pixels instead of the frame size.
+ * Depth follows the zbuffer convention: larger is closer.
+ * A buffer may hold only a crop window of the frame, its pixels then match that part of a full frame buffer.
+ */
+class Buffer {
+  public:
+    /**
+     * @param samples 4 or 8, the patterns that exist. Other counts get 4, callers should reject them.
+     */
+    Buffer(int width, int height, int samples = 4);
+    Buffer(const drawing::Region &region, int samples = 4);
+
+    void clear(TGAColor background = TGAColor(0, 0, 0, 255));
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const drawing::Region &getRegion() const { return region; }
+    int getSamples() const { return samples; }
+    uint32_t fullMask() const { return (1u << samples) - 1; }
+    // sample positions relative to the pixel sample point, in pixels
+    const glm::vec2 *offsets() const;
+    int expandedPixels() const { return expandedCount; }
+
+    /**
+     * Depth tested write of the covered samples of one pixel, x and y are relative to the region
+     * @param z depth of the triangle at the pixel sample point, dzdx and dzdy its screen space slopes
+     */
+    void write(int x, int y, uint32_t coverage, float z, float dzdx, float dzdy, TGAColor color);
+
+    /**
+     * Averages the samples of every pixel into the image
+     */
+    void resolve(TGAImage &image) const;
+
+  private:
+    struct Pixel {
+        uint32_t color;   // TGAColor::val
+        float z;
+        float dzdx;
+        float dzdy;
+        int32_t block;   // first sample in the expanded storage, -1 while compressed
+    };
+
+    int expand(Pixel &pixel);
+
+    drawing::Region region;
+    int width;
+    int height;
+    int samples;
+    int expandedCount{0};
+    std::vector<Pixel> pixels{};
+    std::vector<uint32_t> sampleColors{};
+    std::vector<float> sampleDepths{};
+    std::vector<int32_t> freeBlocks{};
+};
+
+/**
+ * Clips and rasterizes a clip space triangle into the buffer.
+ * shade(bary) is called once per pixel with perspective correct barycentric coordinates in the original
+ * triangle, taken at the pixel sample point and pulled back inside the triangle on partially covered pixels.
+ */
+template <typename Shade> void drawTriangle(const glm::vec4 clip[3], Buffer &buffer, Shade &&shade, bool cullBackFaces = true) {
+    const drawing::Region &region = buffer.getRegion();
+    glm::vec4 polygon[pipeline::MAX_CLIPPED_VERTICES];
+    glm::vec3 weights[pipeline::MAX_CLIPPED_VERTICES];
+    const int n = pipeline::clipTriangle(clip, polygon, weights);
+    if (n < 3) {
+        return;
+    }
+    glm::vec3 screen[pipeline::MAX_CLIPPED_VERTICES];
+    float invW[pipeline::MAX_CLIPPED_VERTICES];
+    for (int k = 0; k < n; k++) {
+        invW[k]   = 1.f / polygon[k].w;
+        screen[k] = pipeline::toScreen(polygon[k], region.frameWidth, region.frameHeight);
+    }
+
+    const int samples        = buffer.getSamples();
+    const glm::vec2 *offsets = buffer.offsets();
+    const uint32_t fullMask  = buffer.fullMask();
+    for (int k = 1; k + 1 < n; k++) {
+        const glm::vec2 p0{screen[0]};
+        const glm::vec2 p1{screen[k]};
+        const glm::vec2 p2{screen[k + 1]};
+        const float area = drawing::edgeFunction(p0, p1, p2);
+        if (area == 0.f || std::isnan(area) || (cullBackFaces && area < 0.f)) {
+            continue;
+        }
+        const float invArea = 1.f / area;
+        const glm::vec3 depth{screen[0].z, screen[k].z, screen[k + 1].z};
+        const glm::vec3 triangleInvW{invW[0], invW[k], invW[k + 1]};
+        const glm::vec3 stepX = glm::vec3{p1.y - p2.y, p2.y - p0.y, p0.y - p1.y} * invArea;
+        const glm::vec3 stepY = glm::vec3{p2.x - p1.x, p0.x - p2.x, p1.x - p0.x} * invArea;
+        const float dzdx      = glm::dot(depth, stepX);
+        const float dzdy      = glm::dot(depth, stepY);
+
+        // a pixel whose sample point is this far inside every edge has all of its samples covered
+        glm::vec3 margin{0.f};
+        for (int s = 0; s < samples; s++) {
+            margin = glm::max(margin, -(stepX * offsets[s].x + stepY * offsets[s].y));
+        }
+
+        // samples reach half a pixel around the sample point.
+        // Rows are stepped from where they start in the full frame, so a crop window gets the same values.
+        const int startX = std::max(0, (int) std::floor(std::min({p0.x, p1.x, p2.x}) - .5f));
+        const int minX   = std::max(region.x, startX);
+        const int minY   = std::max(region.y, (int) std::floor(std::min({p0.y, p1.y, p2.y}) - .5f));
+        const int maxX   = std::min(region.x + region.width - 1, (int) std::ceil(std::max({p0.x, p1.x, p2.x}) + .5f));
+        const int maxY   = std::min(region.y + region.height - 1, (int) std::ceil(std::max({p0.y, p1.y, p2.y}) + .5f));
+        for (int j = minY; j <= maxY; j++) {
+            const glm::vec2 start{startX, j};
+            glm::vec3 bary = glm::vec3{drawing::edgeFunction(p1, p2, start), drawing::edgeFunction(p2, p0, start), drawing::edgeFunction(p0, p1, start)} * invArea;
+            for (int i = startX; i < minX; i++) {
+                bary += stepX;
+            }
+            for (int i = minX; i <= maxX; i++, bary += stepX) {
+                uint32_t coverage = 0;
+                if (bary.x >= margin.x && bary.y >= margin.y && bary.z >= margin.z) {
+                    coverage = fullMask;
+                } else {
+                    for (int s = 0; s < samples; s++) {
+                        const glm::vec3 b = bary + stepX * offsets[s].x + stepY * offsets[s].y;
+                        if (b.x >= 0 && b.y >= 0 && b.z >= 0) {
+                            coverage |= 1u << s;
+                        }
+                    }
+                    if (!coverage) {
+                        continue;
+                    }
+                }
+                glm::vec3 inside = glm::max(bary, glm::vec3{0.f});
+                inside /= inside.x + inside.y + inside.z;
+                const glm::vec3 b = drawing::perspectiveCorrect(inside, triangleInvW);
+                buffer.write(i - region.x, j - region.y, coverage, glm::dot(depth, bary), dzdx, dzdy, shade(weights[0] * b.x + weights[k] * b.y + weights[k + 1] * b.z));
+            }
+        }
+    }
+}
+
+/**
+ * drawing::drawModel into a multisampled buffer, only the region of the buffer is drawn
+ */
+void drawModel(Model &model, const pipeline::Transform &transform, Buffer &buffer);
+
+}   // namespace msaa
@@ -1,4 +1,4 @@
-
+#pragma once
 #include "color.hpp"
 #include "tgaimage.hpp"
 #include <glm/glm.hpp>
@@ -20,4 +20,10 @@ struct Triangle {
     TGAColor color{white};
 };
 
+// Per vertex attributes that get interpolated over a triangle
+struct Varyings {
+    glm::vec2 uv[3];
+    glm::vec3 normal[3];
+};
+
 }   // namespace objects
\ No newline at end of file
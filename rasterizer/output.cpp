@@ -0,0 +1,33 @@
+#include "output.hpp"
+
+namespace output {
+
+TGAWriter::TGAWriter(size_t queueSize) : queue{queueSize} { worker = std::thread{&TGAWriter::run, this}; }
+
+TGAWriter::~TGAWriter() { finish(); }
+
+void TGAWriter::submit(Frame frame) { queue.push(std::move(frame)); }
+
+bool TGAWriter::finish() {
+    if (worker.joinable()) {
+        queue.close();
+        worker.join();
+    }
+    return !failed;
+}
+
+void TGAWriter::run() {
+    Frame frame{};
+    while (queue.pop(frame)) {
+        if (frame.flipVertically) {
+            frame.image.flip_vertically();
+        }
+        if (!frame.image.write_tga_file(frame.filename.c_str(), frame.rle, frame.xOrigin, frame.yOrigin)) {
+            failed = true;
+        }
+        // release the pixels before waiting for the next frame
+        frame.image = TGAImage();
+    }
+}
+
+}   // namespace output
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "tgaimage.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace output {
+
+/**
+ * Fixed capacity FIFO between a producer and a consumer thread.
+ * push blocks while the queue is full, pop blocks while it is empty.
+ * The two programs share no sources, ray_tracer/output.hpp holds the same queue.
+ */
+template <typename T> class BoundedQueue {
+  public:
+    BoundedQueue(size_t capacity) : capacity{capacity > 0 ? capacity : 1} {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock{mutex};
+        notFull.wait(lock, [this] { return items.size() < capacity || closed; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    /**
+     * @return false once the queue is closed and fully drained
+     */
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock{mutex};
+        notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock{mutex};
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+  private:
+    size_t capacity;
+    bool closed{false};
+    std::deque<T> items{};
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+struct Frame {
+    TGAImage image;
+    std::string filename;
+    bool flipVertically{true};
+    bool rle{true};
+    // lower left corner of a cropped frame in the full frame
+    int xOrigin{0};
+    int yOrigin{0};
+};
+
+/**
+ * Flips, rle compresses and writes finished frames from a background thread.
+ * With the default queue size of two the caller can render into a new image
+ * while the previous one is still being written (double buffering).
+ */
+class TGAWriter {
+  public:
+    TGAWriter(size_t queueSize = 2);
+    ~TGAWriter();
+
+    TGAWriter(const TGAWriter &)            = delete;
+    TGAWriter &operator=(const TGAWriter &) = delete;
+
+    // The image is moved into the writer, the caller should start from a fresh one
+    void submit(Frame frame);
+
+    /**
+     * Blocks until every submitted frame is on disk.
+     * @return false if any of the frames could not be written
+     */
+    bool finish();
+
+  private:
+    void run();
+
+    bool failed{false};
+    BoundedQueue<Frame> queue;
+    std::thread worker;
+};
+
+}   // namespace output
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+/**
+ * Runs f(begin, end) over [0, n) split in contiguous blocks, one block per hardware thread.
+ * @param minRows blocks are never made smaller than this, small jobs stay on the calling thread
+ */
+template <typename F> void forRows(int n, F f, int minRows = 16) {
+    const int threads = std::max(1, std::min((int) std::thread::hardware_concurrency(), n / std::max(1, minRows)));
+    if (threads == 1) {
+        f(0, n);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back(f, n * t / threads, n * (t + 1) / threads);
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+}   // namespace parallel
@@ -0,0 +1,159 @@
+#include "pipeline.hpp"
+
+#include <cmath>
+
+namespace {
+
+// How far outside the screen (in screen sizes) vertices may lie before X and Y get clipped
+const float GUARD_BAND = 8.f;
+
+const int CLIP_PLANES = 6;
+
+// Signed distance of a clip space vertex to clip plane p, inside is >= 0
+float planeDistance(int p, glm::vec4 v) {
+    switch (p) {
+        case 0: return v.z + v.w;                // near
+        case 1: return v.w - v.z;                // far
+        case 2: return GUARD_BAND * v.w + v.x;   // left guard band
+        case 3: return GUARD_BAND * v.w - v.x;   // right guard band
+        case 4: return GUARD_BAND * v.w + v.y;   // bottom guard band
+        default: return GUARD_BAND * v.w - v.y;  // top guard band
+    }
+}
+
+int outcode(glm::vec4 v) {
+    int code = 0;
+    for (int p = 0; p < CLIP_PLANES; p++) {
+        if (planeDistance(p, v) < 0.f) {
+            code |= 1 << p;
+        }
+    }
+    return code;
+}
+
+// Outside one of the actual frustum planes
+int frustumOutcode(glm::vec4 v) {
+    return (v.x < -v.w) | (v.x > v.w) << 1 | (v.y < -v.w) << 2 | (v.y > v.w) << 3 | (v.z < -v.w) << 4 | (v.z > v.w) << 5;
+}
+
+}   // namespace
+
+namespace pipeline {
+
+glm::mat4 Transform::normalMatrix() const { return glm::transpose(glm::inverse(model)); }
+
+Frustum::Frustum(const glm::mat4 &m) {
+    // Gribb & Hartmann: the planes are sums and differences of the matrix rows
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4{m[0][i], m[1][i], m[2][i], m[3][i]};
+    }
+    for (int i = 0; i < 3; i++) {
+        planes[2 * i]     = rows[3] + rows[i];
+        planes[2 * i + 1] = rows[3] - rows[i];
+    }
+    for (glm::vec4 &plane : planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+}
+
+bool Frustum::intersectsSphere(glm::vec3 center, float radius) const {
+    for (const glm::vec4 &plane : planes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool isVisible(Model &model, const Transform &transform) {
+    return isVisible(model, transform, drawing::Region::full(1, 1));
+}
+
+glm::mat4 regionMatrix(const drawing::Region &region) {
+    glm::mat4 m{1.f};
+    m[0][0] = (float) region.frameWidth / region.width;
+    m[1][1] = (float) region.frameHeight / region.height;
+    m[3][0] = (float) (region.frameWidth - 2 * region.x) / region.width - 1.f;
+    m[3][1] = (float) (region.frameHeight - 2 * region.y) / region.height - 1.f;
+    return m;
+}
+
+bool isVisible(Model &model, const Transform &transform, const drawing::Region &region) {
+    const glm::vec3 center = glm::vec3(transform.model * glm::vec4(model.bounding_center(), 1.f));
+    // the largest axis scale of the model matrix bounds the scaled radius
+    const float scale = std::max({glm::length(glm::vec3(transform.model[0])), glm::length(glm::vec3(transform.model[1])), glm::length(glm::vec3(transform.model[2]))});
+    return Frustum{regionMatrix(region) * transform.viewProjection()}.intersectsSphere(center, model.bounding_radius() * scale);
+}
+
+void transformVertices(Model &model, const glm::mat4 &mvp, std::vector<glm::vec4> &clip) {
+    clip.resize(model.nverts());
+    for (int i = 0; i < model.nverts(); i++) {
+        clip[i] = mvp * glm::vec4(model.vert(i), 1.f);
+    }
+}
+
+bool clipSegment(glm::vec4 &c0, glm::vec4 &c1) {
+    for (int p = 0; p < 2; p++) {
+        const float d0 = planeDistance(p, c0);
+        const float d1 = planeDistance(p, c1);
+        if (d0 < 0.f && d1 < 0.f) {
+            return false;
+        }
+        if (d0 < 0.f) {
+            c0 = c0 + (c1 - c0) * (d0 / (d0 - d1));
+        } else if (d1 < 0.f) {
+            c1 = c1 + (c0 - c1) * (d1 / (d1 - d0));
+        }
+    }
+    return true;
+}
+
+int clipTriangle(const glm::vec4 triangle[3], glm::vec4 polygon[MAX_CLIPPED_VERTICES], glm::vec3 weights[MAX_CLIPPED_VERTICES]) {
+    const glm::vec3 corners[3] = {{1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}, {0.f, 0.f, 1.f}};
+    for (int k = 0; k < 3; k++) {
+        polygon[k] = triangle[k];
+        weights[k] = corners[k];
+    }
+
+    // completely outside one of the frustum planes
+    if (frustumOutcode(triangle[0]) & frustumOutcode(triangle[1]) & frustumOutcode(triangle[2])) {
+        return 0;
+    }
+    const int codes = outcode(triangle[0]) | outcode(triangle[1]) | outcode(triangle[2]);
+    if (!codes) {
+        return 3;
+    }
+
+    // Sutherland-Hodgman against the planes that are actually crossed
+    int n = 3;
+    for (int p = 0; p < CLIP_PLANES && n > 0; p++) {
+        if (!(codes & (1 << p))) {
+            continue;
+        }
+        glm::vec4 inPolygon[MAX_CLIPPED_VERTICES];
+        glm::vec3 inWeights[MAX_CLIPPED_VERTICES];
+        std::copy(polygon, polygon + n, inPolygon);
+        std::copy(weights, weights + n, inWeights);
+
+        int count = 0;
+        for (int k = 0; k < n; k++) {
+            const int next      = (k + 1) % n;
+            const float dCur    = planeDistance(p, inPolygon[k]);
+            const float dNext   = planeDistance(p, inPolygon[next]);
+            if (dCur >= 0.f) {
+                polygon[count]   = inPolygon[k];
+                weights[count++] = inWeights[k];
+            }
+            if ((dCur >= 0.f) != (dNext >= 0.f)) {
+                const float t    = dCur / (dCur - dNext);
+                polygon[count]   = inPolygon[k] + (inPolygon[next] - inPolygon[k]) * t;
+                weights[count++] = inWeights[k] + (inWeights[next] - inWeights[k]) * t;
+            }
+        }
+        n = count;
+    }
+    return n;
+}
+
+}   // namespace pipeline
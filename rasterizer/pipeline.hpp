@@ -0,0 +1,125 @@
+#pragma once
+
+#include "model.hpp"
+#include "objects.hpp"
+#include "raster.hpp"
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace pipeline {
+
+// Most vertices a triangle can have after clipping against all clip planes
+const int MAX_CLIPPED_VERTICES = 12;
+
+struct Transform {
+    glm::mat4 model{1.f};
+    glm::mat4 view{1.f};
+    glm::mat4 projection{1.f};
+
+    glm::mat4 mvp() const { return projection * view * model; }
+    glm::mat4 viewProjection() const { return projection * view; }
+    // takes model space normals to world space
+    glm::mat4 normalMatrix() const;
+};
+
+class Frustum {
+  public:
+    Frustum(const glm::mat4 &viewProjection);
+
+    bool intersectsSphere(glm::vec3 center, float radius) const;
+
+  private:
+    glm::vec4 planes[6];   // xyz points inwards, normalized
+};
+
+/**
+ * Whether the bounding sphere of the model touches the view frustum
+ */
+bool isVisible(Model &model, const Transform &transform);
+
+/**
+ * Maps clip space so that the region of the frame fills the whole clip volume,
+ * frustum tests against projection * view then only keep what reaches into the region
+ */
+glm::mat4 regionMatrix(const drawing::Region &region);
+
+/**
+ * Whether the bounding sphere of the model reaches into the region of the frame
+ */
+bool isVisible(Model &model, const Transform &transform, const drawing::Region &region);
+
+/**
+ * All model vertices in clip space, indexed like Model::vert
+ */
+void transformVertices(Model &model, const glm::mat4 &mvp, std::vector<glm::vec4> &clip);
+
+/**
+ * From clip space to pixel coordinates, z is stored as depth where larger is closer
+ */
+inline glm::vec3 toScreen(glm::vec4 clip, int width, int height) {
+    const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+    return glm::vec3{(ndc.x + 1.f) * width / 2.f, (ndc.y + 1.f) * height / 2.f, -ndc.z};
+}
+
+/**
+ * Clips a clip space segment against the near and far planes
+ * @return false if nothing is left
+ */
+bool clipSegment(glm::vec4 &c0, glm::vec4 &c1);
+
+/**
+ * Clips a triangle against the near and far planes and a guard band around the screen.
+ * X and Y are only clipped when a vertex leaves the guard band, the rasterizer limits itself to the screen.
+ * @param weights barycentric weights of every output vertex in the input triangle
+ * @return the vertex count of the clipped convex polygon, 0 if nothing is left
+ */
+int clipTriangle(const glm::vec4 triangle[3], glm::vec4 polygon[MAX_CLIPPED_VERTICES], glm::vec3 weights[MAX_CLIPPED_VERTICES]);
+
+/**
+ * Clips, projects and rasterizes a clip space triangle.
+ * fragment(x, y, bary) receives perspective correct barycentric coordinates in the original triangle.
+ * Only the pixels of region are drawn, fragment coordinates and the zbuffer are relative to it.
+ * @param cullBackFaces skip triangles that are clockwise on the screen
+ */
+template <typename Fragment> void drawTriangle(const glm::vec4 clip[3], const drawing::Region &region, float *zbuffer, Fragment &&fragment, bool cullBackFaces = true) {
+    glm::vec4 polygon[MAX_CLIPPED_VERTICES];
+    glm::vec3 weights[MAX_CLIPPED_VERTICES];
+    const int n = clipTriangle(clip, polygon, weights);
+    if (n < 3) {
+        return;
+    }
+
+    glm::vec3 screen[MAX_CLIPPED_VERTICES];
+    float invW[MAX_CLIPPED_VERTICES];
+    for (int k = 0; k < n; k++) {
+        invW[k]   = 1.f / polygon[k].w;
+        screen[k] = toScreen(polygon[k], region.frameWidth, region.frameHeight);
+    }
+
+    // the clipped polygon is convex, draw it as a fan
+    for (int k = 1; k + 1 < n; k++) {
+        const glm::vec2 e1   = glm::vec2(screen[k] - screen[0]);
+        const glm::vec2 e2   = glm::vec2(screen[k + 1] - screen[0]);
+        const float area     = e1.x * e2.y - e1.y * e2.x;
+        if (area == 0.f || (cullBackFaces && area < 0.f)) {
+            continue;
+        }
+        const objects::Triangle triangle{screen[0], screen[k], screen[k + 1]};
+        const glm::vec3 triangleInvW{invW[0], invW[k], invW[k + 1]};
+        drawing::rasterizeTriangle(triangle, region, zbuffer, [&](int x, int y, glm::vec3 bary) {
+            bary = drawing::perspectiveCorrect(bary, triangleInvW);
+            fragment(x, y, weights[0] * bary.x + weights[k] * bary.y + weights[k + 1] * bary.z);
+        });
+    }
+}
+
+/**
+ * drawTriangle over a whole frame of width x height
+ */
+template <typename Fragment> void drawTriangle(const glm::vec4 clip[3], int width, int height, float *zbuffer, Fragment &&fragment, bool cullBackFaces = true) {
+    drawTriangle(clip, drawing::Region::full(width, height), zbuffer, std::forward<Fragment>(fragment), cullBackFaces);
+}
+
+}   // namespace pipeline
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "objects.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+namespace drawing {
+
+// Screen space barycentric coordinates to perspective correct ones
+inline glm::vec3 perspectiveCorrect(glm::vec3 bary, glm::vec3 invW) {
+    const glm::vec3 weighted = bary * invW;
+    return weighted / (weighted.x + weighted.y + weighted.z);
+}
+
+// Twice the signed area of (a, b, p), positive when p lies left of a->b
+inline float edgeFunction(glm::vec2 a, glm::vec2 b, glm::vec2 p) { return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x); }
+
+/**
+ * The pixels [x, x + width) x [y, y + height) of a frame of frameWidth x frameHeight.
+ * Rendering a region gives the same pixels as the matching part of a full frame render.
+ */
+struct Region {
+    int x;
+    int y;
+    int width;
+    int height;
+    int frameWidth;
+    int frameHeight;
+
+    static Region full(int width, int height) { return Region{0, 0, width, height, width, height}; }
+};
+
+/**
+ * Walks the pixels of the region covered by the triangle and updates the zbuffer.
+ * Triangle coordinates are frame pixels, the zbuffer holds region.width * region.height values
+ * and fragment(x, y, bary) receives coordinates relative to the region, for every pixel that passes the depth test.
+ */
+template <typename Fragment> void rasterizeTriangle(const objects::Triangle &triangle, const Region &region, float *zbuffer, Fragment &&fragment) {
+    const glm::vec2 p0{triangle.p0.x, triangle.p0.y};
+    const glm::vec2 p1{triangle.p1.x, triangle.p1.y};
+    const glm::vec2 p2{triangle.p2.x, triangle.p2.y};
+    const float area = edgeFunction(p0, p1, p2);
+    if (area == 0.f || std::isnan(area)) {
+        return;
+    }
+    const float invArea = 1.f / area;
+
+    const int minX = std::max(region.x, (int) std::floor(std::min({p0.x, p1.x, p2.x})));
+    const int minY = std::max(region.y, (int) std::floor(std::min({p0.y, p1.y, p2.y})));
+    const int maxX = std::min(region.x + region.width - 1, (int) std::ceil(std::max({p0.x, p1.x, p2.x})));
+    const int maxY = std::min(region.y + region.height - 1, (int) std::ceil(std::max({p0.y, p1.y, p2.y})));
+
+    // edge functions are affine, step them along the row instead of recomputing them.
+    // They are evaluated afresh on every 8th column of the frame, so a pixel gets the same value
+    // no matter which part of the row the region starts at.
+    const glm::vec3 stepX = glm::vec3{p1.y - p2.y, p2.y - p0.y, p0.y - p1.y} * invArea;
+    auto evaluate         = [&](int x, int y) {
+        const glm::vec2 p{x, y};
+        return glm::vec3{edgeFunction(p1, p2, p), edgeFunction(p2, p0, p), edgeFunction(p0, p1, p)} * invArea;
+    };
+    for (int j = minY; j <= maxY; j++) {
+        const int blockStart = minX & ~7;
+        glm::vec3 bary       = evaluate(blockStart, j);
+        for (int i = blockStart; i < minX; i++) {
+            bary += stepX;
+        }
+        float *zrow = zbuffer + (j - region.y) * region.width - region.x;
+        for (int i = minX; i <= maxX; i++, bary += stepX) {
+            if ((i & 7) == 0) {
+                bary = evaluate(i, j);
+            }
+            if (bary.x < 0 || bary.y < 0 || bary.z < 0)
+                continue;
+            const float z = triangle.p0.z * bary.x + triangle.p1.z * bary.y + triangle.p2.z * bary.z;
+            if (zrow[i] < z) {
+                zrow[i] = z;
+                fragment(i - region.x, j - region.y, bary);
+            }
+        }
+    }
+}
+
+/**
+ * rasterizeTriangle over a whole frame of width x height
+ */
+template <typename Fragment> void rasterizeTriangle(const objects::Triangle &triangle, int width, int height, float *zbuffer, Fragment &&fragment) {
+    rasterizeTriangle(triangle, Region::full(width, height), zbuffer, std::forward<Fragment>(fragment));
+}
+
+}   // namespace drawing
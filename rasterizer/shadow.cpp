@@ -0,0 +1,82 @@
+#include "shadow.hpp"
+
+#include "parallel.hpp"
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace shadow {
+
+ShadowMap::ShadowMap(int size, int pcfRadius) : size{size}, pcfRadius{pcfRadius}, depth((size_t) size * size, -std::numeric_limits<float>::max()) {}
+
+bool ShadowMap::update(Model &model, const glm::mat4 &modelMatrix, glm::vec3 direction, uint64_t geometryVersion) {
+    direction = glm::normalize(direction);
+    if (passes > 0 && this->model == &model && this->modelMatrix == modelMatrix && this->direction == direction && this->geometryVersion == geometryVersion) {
+        return false;
+    }
+    this->model           = &model;
+    this->modelMatrix     = modelMatrix;
+    this->direction       = direction;
+    this->geometryVersion = geometryVersion;
+
+    // the light looks at the bounding sphere from outside of it, the box around it is the whole map
+    const glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(model.bounding_center(), 1.f));
+    const float scale      = std::max({glm::length(glm::vec3(modelMatrix[0])), glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))});
+    const float radius     = std::max(model.bounding_radius() * scale, 1e-6f);
+    const glm::vec3 up     = std::abs(direction.y) > .99f ? glm::vec3{1.f, 0.f, 0.f} : glm::vec3{0.f, 1.f, 0.f};
+    const glm::mat4 view   = glm::lookAt(center - direction * (2.f * radius), center, up);
+    lightMatrix            = glm::ortho(-radius, radius, -radius, radius, radius, 3.f * radius) * view;
+    texelSize              = 2.f * radius / size;
+    depthScale             = 1.f / radius;
+
+    std::vector<glm::vec4> clip;
+    pipeline::transformVertices(model, lightMatrix * modelMatrix, clip);
+    std::vector<glm::ivec3> faces(model.nfaces());
+    for (int i = 0; i < model.nfaces(); i++) {
+        const std::vector<int> face = model.face(i);
+        faces[i]                    = glm::ivec3{face[0], face[1], face[2]};
+    }
+
+    // depth only, both sides of every face cast shadows. Every band of rows is a region of its own.
+    std::fill(depth.begin(), depth.end(), -std::numeric_limits<float>::max());
+    parallel::forRows(size, [&](int begin, int end) {
+        const drawing::Region band{0, begin, size, end - begin, size, size};
+        float *zbuffer = depth.data() + (size_t) begin * size;
+        for (const glm::ivec3 &face : faces) {
+            const glm::vec4 triangle[3] = {clip[face[0]], clip[face[1]], clip[face[2]]};
+            pipeline::drawTriangle(triangle, band, zbuffer, [](int, int, glm::vec3) {}, false);
+        }
+    }, 64);
+    passes++;
+    return true;
+}
+
+float ShadowMap::visibility(glm::vec3 world, float cosine) const {
+    if (passes == 0) {
+        return 1.f;
+    }
+    const glm::vec3 p = pipeline::toScreen(lightMatrix * glm::vec4(world, 1.f), size, size);
+    const int cx      = (int) std::lround(p.x);
+    const int cy      = (int) std::lround(p.y);
+
+    // slope scaled bias: grazing surfaces change depth faster across the filter kernel
+    cosine              = std::max(cosine, 1e-3f);
+    const float tangent = std::sqrt(std::max(0.f, 1.f - cosine * cosine)) / cosine;
+    const float bias    = texelSize * (1.f + std::min(tangent, 4.f) * (pcfRadius + .5f));
+    const float biased  = p.z + bias * depthScale;
+
+    int lit = 0;
+    for (int y = cy - pcfRadius; y <= cy + pcfRadius; y++) {
+        for (int x = cx - pcfRadius; x <= cx + pcfRadius; x++) {
+            lit += x < 0 || y < 0 || x >= size || y >= size || biased >= depth[(size_t) y * size + x];
+        }
+    }
+    const int kernel = 2 * pcfRadius + 1;
+    return (float) lit / (kernel * kernel);
+}
+
+}   // namespace shadow
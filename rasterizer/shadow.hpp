@@ -0,0 +1,71 @@
+#pragma once
+
+#include "model.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace shadow {
+
+// Light that still reaches shadowed pixels and faces turned away from the light, so they don't turn black
+const float AMBIENT = .2f;
+
+/**
+ * @param intensity cosine between the surface normal and the direction towards the light
+ * @param visibility lit fraction from the shadow map
+ */
+inline float shade(float intensity, float visibility) { return AMBIENT + (1.f - AMBIENT) * std::max(0.f, intensity) * visibility; }
+
+/**
+ * Depth of a model seen from a directional light, rendered with the zbuffer path of the main pass
+ * through an orthographic projection fitted around the bounding sphere of the model.
+ * Depth follows the zbuffer convention: larger is closer to the light.
+ */
+class ShadowMap {
+  public:
+    /**
+     * @param size width and height of the depth map
+     * @param pcfRadius visibility averages (2 * pcfRadius + 1)^2 depth comparisons
+     */
+    ShadowMap(int size = 1024, int pcfRadius = 1);
+
+    /**
+     * Renders the depth pass, unless the model, its matrix, the light and the geometry version
+     * are the ones of the last pass: static lights and geometry keep the map across frames.
+     * @param direction the direction the light travels in
+     * @param geometryVersion changes whenever the vertices of the model are edited
+     * @return whether the depth pass ran
+     */
+    bool update(Model &model, const glm::mat4 &modelMatrix, glm::vec3 direction, uint64_t geometryVersion = 0);
+
+    /**
+     * Fraction of the filter kernel around a world space point that is lit, 1 outside of the map
+     * @param cosine between the surface normal and the direction towards the light, scales the depth bias
+     */
+    float visibility(glm::vec3 world, float cosine = 1.f) const;
+
+    glm::vec3 getDirection() const { return direction; }
+    int getSize() const { return size; }
+    // depth passes rendered so far, stays at 1 while the cache holds
+    int getPasses() const { return passes; }
+
+  private:
+    int size;
+    int pcfRadius;
+    std::vector<float> depth;
+    glm::mat4 lightMatrix{1.f};   // world to light clip space
+    float texelSize{0.f};         // world units covered by one texel
+    float depthScale{0.f};        // depth units per world unit along the light
+    int passes{0};
+
+    // key of the cached pass
+    const Model *model{nullptr};
+    glm::mat4 modelMatrix{1.f};
+    glm::vec3 direction{0.f, 0.f, -1.f};
+    uint64_t geometryVersion{0};
+};
+
+}   // namespace shadow
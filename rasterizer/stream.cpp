@@ -0,0 +1,350 @@
+#include "stream.hpp"
+
+#include "drawing.hpp"
+#include "output.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+const char MAGIC[4]    = {'R', 'C', 'H', 'K'};
+const uint32_t VERSION = 1;
+
+// First index of an obj face corner, relative indices count back from the vertices read so far
+bool parseCorner(const std::string &corner, uint32_t vertexCount, uint32_t &index) {
+    long i = std::strtol(corner.c_str(), nullptr, 10);
+    if (i < 0) {
+        i += vertexCount + 1;
+    }
+    if (i < 1 || i > (long) vertexCount) {
+        return false;
+    }
+    index = (uint32_t) (i - 1);
+    return true;
+}
+
+class ChunkBuilder {
+  public:
+    ChunkBuilder(std::ofstream &out, const glm::vec3 *positions) : out{out}, positions{positions} {}
+
+    void add(uint32_t a, uint32_t b, uint32_t c) {
+        faces.push_back(a);
+        faces.push_back(b);
+        faces.push_back(c);
+    }
+
+    size_t faceCount() const { return faces.size() / 3; }
+
+    void flush(std::vector<stream::ChunkInfo> &table) {
+        if (faces.empty()) {
+            return;
+        }
+        std::unordered_map<uint32_t, uint32_t> local;
+        std::vector<glm::vec3> verts;
+        std::vector<uint32_t> indices(faces.size());
+        for (size_t i = 0; i < faces.size(); i++) {
+            auto it = local.emplace(faces[i], (uint32_t) verts.size());
+            if (it.second) {
+                verts.push_back(positions[faces[i]]);
+            }
+            indices[i] = it.first->second;
+        }
+
+        glm::vec3 lo = verts[0], hi = verts[0];
+        for (const glm::vec3 &v : verts) {
+            lo = glm::min(lo, v);
+            hi = glm::max(hi, v);
+        }
+        const glm::vec3 center = (lo + hi) * .5f;
+        float radius           = 0.f;
+        for (const glm::vec3 &v : verts) {
+            radius = std::max(radius, glm::length(v - center));
+        }
+
+        stream::ChunkInfo info{};
+        info.offset      = (uint64_t) out.tellp();
+        info.vertexCount = (uint32_t) verts.size();
+        info.faceCount   = (uint32_t) faceCount();
+        info.center[0]   = center.x;
+        info.center[1]   = center.y;
+        info.center[2]   = center.z;
+        info.radius      = radius;
+        table.push_back(info);
+
+        for (const glm::vec3 &v : verts) {
+            const float p[3] = {v.x, v.y, v.z};
+            out.write((const char *) p, sizeof(p));
+        }
+        out.write((const char *) indices.data(), indices.size() * sizeof(uint32_t));
+        faces.clear();
+    }
+
+  private:
+    std::ofstream &out;
+    const glm::vec3 *positions;
+    std::vector<uint32_t> faces{};
+};
+
+}   // namespace
+
+namespace stream {
+
+bool convertObj(const char *objPath, const char *chunkPath, int facesPerChunk) {
+    std::ifstream in{objPath};
+    if (!in) {
+        std::cerr << "can't open file " << objPath << '\n';
+        return false;
+    }
+
+    // first pass, spool the positions
+    FILE *spool = std::tmpfile();
+    if (!spool) {
+        std::cerr << "can't create a temporary file\n";
+        return false;
+    }
+    uint32_t vertexCount = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 2, "v ")) {
+            continue;
+        }
+        std::istringstream iss(line.c_str() + 2);
+        float p[3] = {0.f, 0.f, 0.f};
+        iss >> p[0] >> p[1] >> p[2];
+        std::fwrite(p, sizeof(p), 1, spool);
+        vertexCount++;
+    }
+    std::fflush(spool);
+    if (vertexCount == 0) {
+        std::fclose(spool);
+        return false;
+    }
+    // the page cache decides how much of the positions stays resident
+    void *mapped = mmap(nullptr, (size_t) vertexCount * sizeof(glm::vec3), PROT_READ, MAP_PRIVATE, fileno(spool), 0);
+    if (mapped == MAP_FAILED) {
+        std::fclose(spool);
+        std::cerr << "can't map the vertex spool\n";
+        return false;
+    }
+    const glm::vec3 *positions = (const glm::vec3 *) mapped;
+
+    // second pass, triangulate the faces into a spool of their own
+    in.clear();
+    in.seekg(0);
+    FILE *triangles = std::tmpfile();
+    if (!triangles) {
+        munmap(mapped, (size_t) vertexCount * sizeof(glm::vec3));
+        std::fclose(spool);
+        std::cerr << "can't create a temporary file\n";
+        return false;
+    }
+    uint32_t triangleCount = 0;
+    uint32_t verticesSoFar = 0;
+    bool valid             = true;
+    while (valid && std::getline(in, line)) {
+        if (!line.compare(0, 2, "v ")) {
+            verticesSoFar++;
+            continue;
+        }
+        if (line.compare(0, 2, "f ")) {
+            continue;
+        }
+        std::istringstream iss(line.c_str() + 2);
+        std::string corner;
+        std::vector<uint32_t> polygon;
+        uint32_t index;
+        while (iss >> corner) {
+            if (!parseCorner(corner, verticesSoFar, index)) {
+                std::cerr << "bad face in " << objPath << ": " << line << '\n';
+                valid = false;
+                break;
+            }
+            polygon.push_back(index);
+        }
+        for (size_t k = 2; valid && k < polygon.size(); k++) {
+            const uint32_t triangle[3] = {polygon[0], polygon[k - 1], polygon[k]};
+            std::fwrite(triangle, sizeof(triangle), 1, triangles);
+            triangleCount++;
+        }
+    }
+    std::fflush(triangles);
+
+    // the chunks go to a temporary file that only replaces chunkPath once it is complete
+    const std::string partial = std::string{chunkPath} + ".tmp";
+    std::ofstream out{partial, std::ios::binary};
+    FileHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    out.write((const char *) &header, sizeof(header));
+
+    std::vector<ChunkInfo> table;
+    const size_t triangleBytes = (size_t) triangleCount * 3 * sizeof(uint32_t);
+    void *mappedTriangles      = triangleCount == 0 ? nullptr : mmap(nullptr, triangleBytes, PROT_READ, MAP_PRIVATE, fileno(triangles), 0);
+    if (mappedTriangles == MAP_FAILED) {
+        std::cerr << "can't map the face spool\n";
+        valid = false;
+    } else if (valid) {
+        // Chunks are cut spatially: the triangles are split at the median of their centroids along the longest
+        // axis until every part fits into a chunk, so the chunk bounds hardly overlap and culling can skip them.
+        // Only a 32 bit index per triangle stays in memory.
+        const uint32_t *faces = (const uint32_t *) mappedTriangles;
+        auto centroid         = [&](uint32_t t) { return positions[faces[t * 3]] + positions[faces[t * 3 + 1]] + positions[faces[t * 3 + 2]]; };
+        std::vector<uint32_t> order(triangleCount);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            order[t] = t;
+        }
+        ChunkBuilder builder{out, positions};
+        std::function<void(size_t, size_t)> split = [&](size_t begin, size_t end) {
+            if (end - begin <= (size_t) facesPerChunk) {
+                for (size_t i = begin; i < end; i++) {
+                    builder.add(faces[order[i] * 3], faces[order[i] * 3 + 1], faces[order[i] * 3 + 2]);
+                }
+                builder.flush(table);
+                return;
+            }
+            glm::vec3 lo{std::numeric_limits<float>::max()};
+            glm::vec3 hi{-std::numeric_limits<float>::max()};
+            for (size_t i = begin; i < end; i++) {
+                const glm::vec3 c = centroid(order[i]);
+                lo                = glm::min(lo, c);
+                hi                = glm::max(hi, c);
+            }
+            const glm::vec3 extent = hi - lo;
+            const int axis         = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+            // whole chunks on the left, so only the last chunk of the file can be partly filled
+            const size_t chunks = (end - begin + facesPerChunk - 1) / facesPerChunk;
+            const size_t middle = begin + chunks / 2 * facesPerChunk;
+            std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](uint32_t a, uint32_t b) { return centroid(a)[axis] < centroid(b)[axis]; });
+            split(begin, middle);
+            split(middle, end);
+        };
+        split(0, order.size());
+    }
+    if (mappedTriangles && mappedTriangles != MAP_FAILED) {
+        munmap(mappedTriangles, triangleBytes);
+    }
+    std::fclose(triangles);
+    munmap(mapped, (size_t) vertexCount * sizeof(glm::vec3));
+    std::fclose(spool);
+
+    header.chunkCount  = (uint32_t) table.size();
+    header.tableOffset = (uint64_t) out.tellp();
+    out.write((const char *) table.data(), table.size() * sizeof(ChunkInfo));
+    out.seekp(0);
+    out.write((const char *) &header, sizeof(header));
+    out.close();
+    if (!out.good()) {
+        std::cerr << "can't write file " << partial << '\n';
+        valid = false;
+    }
+    if (!valid || std::rename(partial.c_str(), chunkPath)) {
+        std::remove(partial.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool outdated(const char *chunkPath, const char *objPath) {
+    struct stat chunks;
+    struct stat obj;
+    if (stat(chunkPath, &chunks)) {
+        return true;
+    }
+    if (stat(objPath, &obj)) {
+        return false;
+    }
+    return obj.st_mtim.tv_sec != chunks.st_mtim.tv_sec ? obj.st_mtim.tv_sec > chunks.st_mtim.tv_sec : obj.st_mtim.tv_nsec > chunks.st_mtim.tv_nsec;
+}
+
+bool ChunkedMesh::open(const char *path) {
+    chunks.clear();
+    in.close();
+    in.open(path, std::ios::binary);
+    FileHeader header{};
+    if (!in.read((char *) &header, sizeof(header)) || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) || header.version != VERSION) {
+        return false;
+    }
+    chunks.resize(header.chunkCount);
+    in.seekg(header.tableOffset);
+    return (bool) in.read((char *) chunks.data(), chunks.size() * sizeof(ChunkInfo));
+}
+
+std::unique_ptr<Model> ChunkedMesh::load(int i) {
+    const ChunkInfo &chunk = chunks[i];
+    std::vector<glm::vec3> verts(chunk.vertexCount);
+    std::vector<uint32_t> indices((size_t) chunk.faceCount * 3);
+    std::vector<float> positions((size_t) chunk.vertexCount * 3);
+    in.seekg(chunk.offset);
+    in.read((char *) positions.data(), positions.size() * sizeof(float));
+    in.read((char *) indices.data(), indices.size() * sizeof(uint32_t));
+    if (!in) {
+        return nullptr;
+    }
+    for (size_t v = 0; v < verts.size(); v++) {
+        verts[v] = glm::vec3{positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]};
+    }
+    std::vector<std::vector<glm::ivec3>> faces(chunk.faceCount);
+    for (size_t f = 0; f < faces.size(); f++) {
+        for (int j = 0; j < 3; j++) {
+            faces[f].push_back(glm::ivec3{(int) indices[f * 3 + j], -1, -1});
+        }
+    }
+    return std::unique_ptr<Model>{new Model{verts, {}, {}, faces}};
+}
+
+StreamStats draw(ChunkedMesh &mesh, const pipeline::Transform &transform, TGAImage &image, float *zbuffer, size_t prefetch) {
+    return draw(mesh, transform, image, zbuffer, drawing::Region::full(image.get_width(), image.get_height()), prefetch);
+}
+
+StreamStats draw(ChunkedMesh &mesh, const pipeline::Transform &transform, TGAImage &image, float *zbuffer, const drawing::Region &region, size_t prefetch) {
+    StreamStats stats{};
+    stats.chunks = mesh.chunkCount();
+
+    // the reader only touches chunks that reach into the frustum of the region
+    const pipeline::Frustum frustum{pipeline::regionMatrix(region) * transform.mvp()};
+    std::vector<int> visible;
+    for (int i = 0; i < mesh.chunkCount(); i++) {
+        const ChunkInfo &info = mesh.info(i);
+        if (frustum.intersectsSphere(glm::vec3{info.center[0], info.center[1], info.center[2]}, info.radius)) {
+            visible.push_back(i);
+        } else {
+            stats.culled++;
+        }
+    }
+
+    output::BoundedQueue<std::unique_ptr<Model>> queue{prefetch};
+    std::thread reader{[&] {
+        for (int i : visible) {
+            std::unique_ptr<Model> chunk = mesh.load(i);
+            if (!chunk) {
+                std::cerr << "can't read chunk " << i << '\n';
+                break;
+            }
+            queue.push(std::move(chunk));
+        }
+        queue.close();
+    }};
+
+    std::unique_ptr<Model> chunk;
+    while (queue.pop(chunk)) {
+        drawing::drawModel(*chunk, transform, image, zbuffer, region);
+        stats.faces += chunk->nfaces();
+        chunk.reset();
+    }
+    reader.join();
+    return stats;
+}
+
+}   // namespace stream
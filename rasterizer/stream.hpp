@@ -0,0 +1,87 @@
+#pragma once
+
+#include "model.hpp"
+#include "pipeline.hpp"
+#include "tgaimage.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+namespace stream {
+
+/**
+ * Chunked mesh file layout, native byte order:
+ *   FileHeader
+ *   chunks, each vertexCount positions (3 floats) followed by faceCount triangles (3 uint32 local indices)
+ *   ChunkInfo table of chunkCount entries at tableOffset
+ * Every chunk is self contained so it can be drawn and dropped on its own.
+ */
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t chunkCount;
+    uint32_t reserved;
+    uint64_t tableOffset;
+};
+
+struct ChunkInfo {
+    uint64_t offset;
+    uint32_t vertexCount;
+    uint32_t faceCount;
+    float center[3];   // bounding sphere of the chunk
+    float radius;
+};
+
+/**
+ * Converts a wavefront obj into the chunked format without holding the mesh in memory.
+ * Vertex positions and triangles are spooled to memory mapped temporary files, faces are triangulated
+ * and cut into spatially compact chunks by median splits of their centroids.
+ * chunkPath is only replaced once the conversion succeeded.
+ */
+bool convertObj(const char *objPath, const char *chunkPath, int facesPerChunk = 65536);
+
+/**
+ * @return true if chunkPath is missing or older than the obj it was converted from
+ */
+bool outdated(const char *chunkPath, const char *objPath);
+
+class ChunkedMesh {
+  public:
+    bool open(const char *path);
+
+    int chunkCount() const { return (int) chunks.size(); }
+    const ChunkInfo &info(int i) const { return chunks[i]; }
+
+    /**
+     * Reads one chunk as a model of its own, nullptr on read errors.
+     * Chunks should be loaded in order and from a single thread.
+     */
+    std::unique_ptr<Model> load(int i);
+
+  private:
+    std::ifstream in{};
+    std::vector<ChunkInfo> chunks{};
+};
+
+struct StreamStats {
+    int chunks{0};
+    int culled{0};   // outside the frustum, never read
+    size_t faces{0};
+};
+
+/**
+ * Flat shades the mesh chunk by chunk into the zbuffer.
+ * A reader thread loads the visible chunks ahead of the rasterizer, at most prefetch
+ * chunks wait in memory besides the one being drawn.
+ */
+StreamStats draw(ChunkedMesh &mesh, const pipeline::Transform &transform, TGAImage &image, float *zbuffer, size_t prefetch = 2);
+
+/**
+ * draw into a crop window, chunks outside the region are culled before they are read
+ */
+StreamStats draw(ChunkedMesh &mesh, const pipeline::Transform &transform, TGAImage &image, float *zbuffer, const drawing::Region &region, size_t prefetch = 2);
+
+}   // namespace stream
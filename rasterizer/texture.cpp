@@ -0,0 +1,126 @@
+#include "texture.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const int TILE_SHIFT = 3;   // 8x8 texels per tile
+const int TILE_SIZE  = 1 << TILE_SHIFT;
+const int TILE_MASK  = TILE_SIZE - 1;
+
+// Interleave the bits of the in-tile coordinates
+inline uint32_t morton(uint32_t x, uint32_t y) {
+    auto spread = [](uint32_t v) { return (v & 1) | ((v & 2) << 1) | ((v & 4) << 2); };
+    return spread(x) | (spread(y) << 1);
+}
+
+inline int wrap(int v, int size) {
+    v %= size;
+    return v < 0 ? v + size : v;
+}
+
+glm::vec4 unpack(uint32_t texel) { return glm::vec4{float(texel & 0xff), float((texel >> 8) & 0xff), float((texel >> 16) & 0xff), float(texel >> 24)}; }
+
+}   // namespace
+
+uint32_t Texture::Level::fetch(int x, int y) const {
+    const int tile = (y >> TILE_SHIFT) * tilesX + (x >> TILE_SHIFT);
+    return texels[(tile << (2 * TILE_SHIFT)) + morton(x & TILE_MASK, y & TILE_MASK)];
+}
+
+bool Texture::load(const char *filename) {
+    TGAImage image;
+    if (!image.read_tga_file(filename)) {
+        return false;
+    }
+    // uv (0, 0) is the bottom left of the texture
+    image.flip_vertically();
+    return fromImage(image);
+}
+
+bool Texture::fromImage(const TGAImage &image) {
+    std::vector<TGAImage> mipmaps;
+    if (!image.build_mipmaps(mipmaps)) {
+        return false;
+    }
+
+    levels.clear();
+    for (TGAImage &mip : mipmaps) {
+        Level level;
+        level.width  = mip.get_width();
+        level.height = mip.get_height();
+        level.tilesX = (level.width + TILE_MASK) >> TILE_SHIFT;
+        const int tilesY = (level.height + TILE_MASK) >> TILE_SHIFT;
+        level.texels.assign((size_t) level.tilesX * tilesY * TILE_SIZE * TILE_SIZE, 0);
+
+        const int bytespp        = mip.get_bytespp();
+        const unsigned char *src = mip.buffer();
+        for (int y = 0; y < level.height; y++) {
+            for (int x = 0; x < level.width; x++) {
+                const unsigned char *p = src + ((size_t) y * level.width + x) * bytespp;
+                uint32_t texel;
+                if (bytespp == TGAImage::GRAYSCALE) {
+                    texel = p[0] | (p[0] << 8) | (p[0] << 16) | 0xff000000u;
+                } else if (bytespp == TGAImage::RGB) {
+                    texel = p[0] | (p[1] << 8) | (p[2] << 16) | 0xff000000u;
+                } else {
+                    memcpy(&texel, p, 4);
+                }
+                const int tile = (y >> TILE_SHIFT) * level.tilesX + (x >> TILE_SHIFT);
+                level.texels[(tile << (2 * TILE_SHIFT)) + morton(x & TILE_MASK, y & TILE_MASK)] = texel;
+            }
+        }
+        levels.push_back(std::move(level));
+    }
+    return true;
+}
+
+glm::vec4 Texture::bilinear(const Level &level, glm::vec2 uv) const {
+    const float x  = uv.x * level.width - .5f;
+    const float y  = uv.y * level.height - .5f;
+    const float fx = std::floor(x);
+    const float fy = std::floor(y);
+    const float tx = x - fx;
+    const float ty = y - fy;
+
+    const int x0 = wrap((int) fx, level.width);
+    const int y0 = wrap((int) fy, level.height);
+    const int x1 = x0 + 1 == level.width ? 0 : x0 + 1;
+    const int y1 = y0 + 1 == level.height ? 0 : y0 + 1;
+
+    const glm::vec4 top    = glm::mix(unpack(level.fetch(x0, y0)), unpack(level.fetch(x1, y0)), tx);
+    const glm::vec4 bottom = glm::mix(unpack(level.fetch(x0, y1)), unpack(level.fetch(x1, y1)), tx);
+    return glm::mix(top, bottom, ty);
+}
+
+TGAColor Texture::sample(glm::vec2 uv, float lod) const {
+    if (levels.empty()) {
+        return TGAColor(255, 255, 255, 255);
+    }
+    lod            = std::max(0.f, std::min(lod, float(levels.size() - 1)));
+    const int l0   = (int) lod;
+    const int l1   = std::min(l0 + 1, (int) levels.size() - 1);
+    const float t  = lod - l0;
+    glm::vec4 bgra = bilinear(levels[l0], uv);
+    if (t > 0.f && l1 != l0) {
+        bgra = glm::mix(bgra, bilinear(levels[l1], uv), t);
+    }
+    return TGAColor(bgra[2] + .5f, bgra[1] + .5f, bgra[0] + .5f, bgra[3] + .5f);
+}
+
+float Texture::triangleLod(const glm::vec2 uv[3], const glm::vec3 screen[3]) const {
+    const glm::vec2 du = (uv[1] - uv[0]) * glm::vec2(getWidth(), getHeight());
+    const glm::vec2 dv = (uv[2] - uv[0]) * glm::vec2(getWidth(), getHeight());
+    const glm::vec2 s1 = glm::vec2(screen[1] - screen[0]);
+    const glm::vec2 s2 = glm::vec2(screen[2] - screen[0]);
+
+    const float texelArea = std::abs(du.x * dv.y - du.y * dv.x);
+    const float pixelArea = std::abs(s1.x * s2.y - s1.y * s2.x);
+    if (pixelArea <= 0.f || texelArea <= 0.f) {
+        return 0.f;
+    }
+    // every doubling of the texel to pixel ratio along one axis is one level
+    return std::max(0.f, .5f * std::log2(texelArea / pixelArea));
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "tgaimage.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Mipmapped texture for the rasterizer.
+ * Every level is stored in 8x8 texel tiles with the texels inside a tile in morton order,
+ * so the 2x2 footprint of a bilinear fetch nearly always lies within one tile.
+ * Texture coordinates wrap around.
+ */
+class Texture {
+  public:
+    Texture(){};
+
+    bool load(const char *filename);
+    bool fromImage(const TGAImage &image);
+
+    bool empty() const { return levels.empty(); }
+    int levelCount() const { return (int) levels.size(); }
+    int getWidth() const { return levels.empty() ? 0 : levels[0].width; }
+    int getHeight() const { return levels.empty() ? 0 : levels[0].height; }
+
+    /**
+     * Trilinear lookup
+     * @param lod log2 of the texels covered by one pixel, 0 is the full resolution level
+     */
+    TGAColor sample(glm::vec2 uv, float lod) const;
+
+    /**
+     * Level of detail of a whole triangle from the ratio of its texel and pixel areas
+     */
+    float triangleLod(const glm::vec2 uv[3], const glm::vec3 screen[3]) const;
+
+  private:
+    struct Level {
+        int width;
+        int height;
+        int tilesX;
+        std::vector<uint32_t> texels;   // bgra
+
+        uint32_t fetch(int x, int y) const;
+    };
+
+    glm::vec4 bilinear(const Level &level, glm::vec2 uv) const;
+
+    std::vector<Level> levels{};
+};
@@ -1,8 +1,12 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
 #include <math.h>
+#include <vector>
+#include "parallel.hpp"
 #include "tgaimage.hpp"
 
 TGAImage::TGAImage() : data(NULL), width(0), height(0), bytespp(0) {
@@ -23,6 +27,11 @@ TGAImage::TGAImage(const TGAImage &img) {
 	memcpy(data, img.data, nbytes);
 }
 
+TGAImage::TGAImage(TGAImage &&img) : data(img.data), width(img.width), height(img.height), bytespp(img.bytespp) {
+	img.data = NULL;
+	img.width = img.height = img.bytespp = 0;
+}
+
 TGAImage::~TGAImage() {
 	if (data) delete [] data;
 }
@@ -40,6 +49,19 @@ TGAImage & TGAImage::operator =(const TGAImage &img) {
 	return *this;
 }
 
+TGAImage & TGAImage::operator =(TGAImage &&img) {
+	if (this != &img) {
+		if (data) delete [] data;
+		data    = img.data;
+		width   = img.width;
+		height  = img.height;
+		bytespp = img.bytespp;
+		img.data = NULL;
+		img.width = img.height = img.bytespp = 0;
+	}
+	return *this;
+}
+
 bool TGAImage::read_tga_file(const char *filename) {
 	if (data) delete [] data;
 	data = NULL;
@@ -96,56 +118,82 @@ bool TGAImage::read_tga_file(const char *filename) {
 	return true;
 }
 
+// Length in pixels (at most n) of the run of pixels equal to the one at p.
+// A run of equal pixels is a byte sequence that repeats with period bytespp,
+// so it is found by comparing the buffer with itself shifted by one pixel, a word at a time.
+static unsigned long equal_run(const unsigned char *p, unsigned long n, int bytespp) {
+	const unsigned long nbytes = (n-1)*bytespp;
+	const unsigned char *q = p+bytespp;
+	unsigned long i = 0;
+	for (; i+8<=nbytes; i+=8) {
+		uint64_t a, b;
+		memcpy(&a, p+i, 8);
+		memcpy(&b, q+i, 8);
+		if (a!=b) {
+			i += __builtin_ctzll(a^b)>>3; // first differing byte, little endian
+			return 1+i/bytespp;
+		}
+	}
+	while (i<nbytes && p[i]==q[i]) i++;
+	return 1+i/bytespp;
+}
+
+static inline bool pixel_equal(const unsigned char *a, const unsigned char *b, int bytespp) {
+	switch (bytespp) {
+		case 1: return a[0]==b[0];
+		case 4: { uint32_t x, y; memcpy(&x, a, 4); memcpy(&y, b, 4); return x==y; }
+		default: return memcmp(a, b, bytespp)==0;
+	}
+}
+
 bool TGAImage::load_rle_data(std::ifstream &in) {
-	unsigned long pixelcount = width*height;
-	unsigned long currentpixel = 0;
-	unsigned long currentbyte  = 0;
-	TGAColor colorbuffer;
-	do {
-		unsigned char chunkheader = 0;
-		chunkheader = in.get();
-		if (!in.good()) {
+	// decode from memory instead of one stream call per chunk
+	std::streampos start = in.tellg();
+	in.seekg(0, std::ios::end);
+	unsigned long nin = in.tellg()-start;
+	in.seekg(start);
+	std::vector<unsigned char> input(nin);
+	in.read((char *)input.data(), nin);
+	if (!in.good()) {
+		std::cerr << "an error occured while reading the data\n";
+		return false;
+	}
+	const unsigned long nbytes = (unsigned long)width*height*bytespp;
+	unsigned long inpos = 0;
+	unsigned long currentbyte = 0;
+	while (currentbyte<nbytes) {
+		if (inpos>=nin) {
 			std::cerr << "an error occured while reading the data\n";
 			return false;
 		}
-		if (chunkheader<128) {
-			chunkheader++;
-			for (int i=0; i<chunkheader; i++) {
-				in.read((char *)colorbuffer.raw, bytespp);
-				if (!in.good()) {
-					std::cerr << "an error occured while reading the header\n";
-					return false;
-				}
-				for (int t=0; t<bytespp; t++)
-					data[currentbyte++] = colorbuffer.raw[t];
-				currentpixel++;
-				if (currentpixel>pixelcount) {
-					std::cerr << "Too many pixels read\n";
-					return false;
-				}
-			}
-		} else {
-			chunkheader -= 127;
-			in.read((char *)colorbuffer.raw, bytespp);
-			if (!in.good()) {
-				std::cerr << "an error occured while reading the header\n";
-				return false;
-			}
-			for (int i=0; i<chunkheader; i++) {
-				for (int t=0; t<bytespp; t++)
-					data[currentbyte++] = colorbuffer.raw[t];
-				currentpixel++;
-				if (currentpixel>pixelcount) {
-					std::cerr << "Too many pixels read\n";
-					return false;
-				}
-			}
+		unsigned char chunkheader = input[inpos++];
+		bool raw = chunkheader<128;
+		unsigned long run = raw ? chunkheader+1 : chunkheader-127;
+		unsigned long runbytes = run*bytespp;
+		if (currentbyte+runbytes>nbytes) {
+			std::cerr << "Too many pixels read\n";
+			return false;
+		}
+		unsigned long insize = raw ? runbytes : bytespp;
+		if (inpos+insize>nin) {
+			std::cerr << "an error occured while reading the header\n";
+			return false;
+		}
+		unsigned char *dst = data+currentbyte;
+		memcpy(dst, input.data()+inpos, insize);
+		// repeat the pixel by doubling the already written part
+		for (unsigned long filled=insize; filled<runbytes; filled*=2) {
+			memcpy(dst+filled, dst, std::min(filled, runbytes-filled));
 		}
-	} while (currentpixel < pixelcount);
+		inpos += insize;
+		currentbyte += runbytes;
+	}
+	// leave the stream right after the pixel data
+	in.seekg(start+(std::streamoff)inpos);
 	return true;
 }
 
-bool TGAImage::write_tga_file(const char *filename, bool rle) {
+bool TGAImage::write_tga_file(const char *filename, bool rle, int x_origin, int y_origin) {
 	unsigned char developer_area_ref[4] = {0, 0, 0, 0};
 	unsigned char extension_area_ref[4] = {0, 0, 0, 0};
 	unsigned char footer[18] = {'T','R','U','E','V','I','S','I','O','N','-','X','F','I','L','E','.','\0'};
@@ -161,41 +209,25 @@ bool TGAImage::write_tga_file(const char *filename, bool rle) {
 	header.bitsperpixel = bytespp<<3;
 	header.width  = width;
 	header.height = height;
+	header.x_origin = x_origin; // where a cropped image sits in the full frame
+	header.y_origin = y_origin;
 	header.datatypecode = (bytespp==GRAYSCALE?(rle?11:3):(rle?10:2));
 	header.imagedescriptor = 0x20; // top-left origin
-	out.write((char *)&header, sizeof(header));
-	if (!out.good()) {
-		out.close();
-		std::cerr << "can't dump the tga file\n";
-		return false;
-	}
+
+	// assemble the whole file and dump it with a single write
+	const unsigned long nbytes = (unsigned long)width*height*bytespp;
+	std::vector<unsigned char> file;
+	file.reserve(sizeof(header)+nbytes+nbytes/128+1+sizeof(developer_area_ref)+sizeof(extension_area_ref)+sizeof(footer));
+	file.insert(file.end(), (unsigned char *)&header, (unsigned char *)&header+sizeof(header));
 	if (!rle) {
-		out.write((char *)data, width*height*bytespp);
-		if (!out.good()) {
-			std::cerr << "can't unload raw data\n";
-			out.close();
-			return false;
-		}
+		file.insert(file.end(), data, data+nbytes);
 	} else {
-		if (!unload_rle_data(out)) {
-			out.close();
-			std::cerr << "can't unload rle data\n";
-			return false;
-		}
-	}
-	out.write((char *)developer_area_ref, sizeof(developer_area_ref));
-	if (!out.good()) {
-		std::cerr << "can't dump the tga file\n";
-		out.close();
-		return false;
+		unload_rle_data(file);
 	}
-	out.write((char *)extension_area_ref, sizeof(extension_area_ref));
-	if (!out.good()) {
-		std::cerr << "can't dump the tga file\n";
-		out.close();
-		return false;
-	}
-	out.write((char *)footer, sizeof(footer));
+	file.insert(file.end(), developer_area_ref, developer_area_ref+sizeof(developer_area_ref));
+	file.insert(file.end(), extension_area_ref, extension_area_ref+sizeof(extension_area_ref));
+	file.insert(file.end(), footer, footer+sizeof(footer));
+	out.write((char *)file.data(), file.size());
 	if (!out.good()) {
 		std::cerr << "can't dump the tga file\n";
 		out.close();
@@ -205,47 +237,30 @@ bool TGAImage::write_tga_file(const char *filename, bool rle) {
 	return true;
 }
 
-// TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the resulting size)
-bool TGAImage::unload_rle_data(std::ofstream &out) {
-	const unsigned char max_chunk_length = 128;
-	unsigned long npixels = width*height;
+// Two equal pixels end a raw chunk; a run of them costs less than spelling them out.
+void TGAImage::unload_rle_data(std::vector<unsigned char> &out) {
+	const unsigned long max_chunk_length = 128;
+	const unsigned long npixels = (unsigned long)width*height;
 	unsigned long curpix = 0;
 	while (curpix<npixels) {
-		unsigned long chunkstart = curpix*bytespp;
-		unsigned long curbyte = curpix*bytespp;
-		unsigned char run_length = 1;
-		bool raw = true;
-		while (curpix+run_length<npixels && run_length<max_chunk_length) {
-			bool succ_eq = true;
-			for (int t=0; succ_eq && t<bytespp; t++) {
-				succ_eq = (data[curbyte+t]==data[curbyte+t+bytespp]);
-			}
-			curbyte += bytespp;
-			if (1==run_length) {
-				raw = !succ_eq;
-			}
-			if (raw && succ_eq) {
-				run_length--;
-				break;
-			}
-			if (!raw && !succ_eq) {
-				break;
+		const unsigned long limit = std::min(max_chunk_length, npixels-curpix);
+		const unsigned char *chunk = data+curpix*bytespp;
+		unsigned long run_length = equal_run(chunk, limit, bytespp);
+		if (run_length>1) {
+			out.push_back(run_length+127);
+			out.insert(out.end(), chunk, chunk+bytespp);
+		} else {
+			// a raw chunk stops right before the next pair of equal pixels
+			run_length = 1;
+			while (run_length<limit && !(curpix+run_length+1<npixels
+					&& pixel_equal(chunk+run_length*bytespp, chunk+(run_length+1)*bytespp, bytespp))) {
+				run_length++;
 			}
-			run_length++;
+			out.push_back(run_length-1);
+			out.insert(out.end(), chunk, chunk+run_length*bytespp);
 		}
 		curpix += run_length;
-		out.put(raw?run_length-1:run_length+127);
-		if (!out.good()) {
-			std::cerr << "can't dump the tga file\n";
-			return false;
-		}
-		out.write((char *)(data+chunkstart), (raw?run_length*bytespp:bytespp));
-		if (!out.good()) {
-			std::cerr << "can't dump the tga file\n";
-			return false;
-		}
 	}
-	return true;
 }
 
 TGAColor TGAImage::get(int x, int y) {
@@ -277,13 +292,19 @@ int TGAImage::get_height() {
 
 bool TGAImage::flip_horizontally() {
 	if (!data) return false;
-	int half = width>>1;
-	for (int i=0; i<half; i++) {
-		for (int j=0; j<height; j++) {
-			TGAColor c1 = get(i, j);
-			TGAColor c2 = get(width-1-i, j);
-			set(i, j, c2);
-			set(width-1-i, j, c1);
+	const unsigned long bytes_per_line = (unsigned long)width*bytespp;
+	for (int j=0; j<height; j++) {
+		unsigned char *line = data+j*bytes_per_line;
+		// reversing the bytes of the line reverses the pixel order but also the channels,
+		// so put the channels of every pixel back afterwards
+		std::reverse(line, line+bytes_per_line);
+		if (bytespp==RGB) {
+			for (unsigned long i=0; i<bytes_per_line; i+=3) std::swap(line[i], line[i+2]);
+		} else if (bytespp==RGBA) {
+			for (unsigned long i=0; i<bytes_per_line; i+=4) {
+				std::swap(line[i], line[i+3]);
+				std::swap(line[i+1], line[i+2]);
+			}
 		}
 	}
 	return true;
@@ -291,17 +312,13 @@ bool TGAImage::flip_horizontally() {
 
 bool TGAImage::flip_vertically() {
 	if (!data) return false;
-	unsigned long bytes_per_line = width*bytespp;
-	unsigned char *line = new unsigned char[bytes_per_line];
+	const unsigned long bytes_per_line = (unsigned long)width*bytespp;
 	int half = height>>1;
 	for (int j=0; j<half; j++) {
-		unsigned long l1 = j*bytes_per_line;
-		unsigned long l2 = (height-1-j)*bytes_per_line;
-		memmove((void *)line,      (void *)(data+l1), bytes_per_line);
-		memmove((void *)(data+l1), (void *)(data+l2), bytes_per_line);
-		memmove((void *)(data+l2), (void *)line,      bytes_per_line);
+		unsigned char *l1 = data+j*bytes_per_line;
+		unsigned char *l2 = data+(height-1-j)*bytes_per_line;
+		std::swap_ranges(l1, l1+bytes_per_line, l2);
 	}
-	delete [] line;
 	return true;
 }
 
@@ -313,35 +330,134 @@ void TGAImage::clear() {
 	memset((void *)data, 0, width*height*bytespp);
 }
 
+static float filter_support(TGAImage::Filter filter) {
+	switch (filter) {
+		case TGAImage::BOX:      return .5f;
+		case TGAImage::BILINEAR: return 1.f;
+		case TGAImage::LANCZOS:  return 3.f;
+		default:                 return 0.f;
+	}
+}
+
+static float filter_weight(TGAImage::Filter filter, float x) {
+	x = fabsf(x);
+	switch (filter) {
+		case TGAImage::BOX:
+			return x<=.5f ? 1.f : 0.f;
+		case TGAImage::BILINEAR:
+			return x<1.f ? 1.f-x : 0.f;
+		case TGAImage::LANCZOS: {
+			if (x<1e-6f) return 1.f;
+			if (x>=3.f) return 0.f;
+			const float px = (float)M_PI*x;
+			return 3.f*sinf(px)*sinf(px/3.f)/(px*px);
+		}
+		default:
+			return 0.f;
+	}
+}
+
+// Normalized filter taps of every output sample along one axis
+struct Contributions {
+	int taps;
+	std::vector<int> first;      // first input sample per output sample
+	std::vector<float> weights;  // taps weights per output sample
+};
+
+static Contributions contributions(int in, int out, TGAImage::Filter filter) {
+	const float ratio = (float)in/out;
+	// widen the filter when minifying so every input sample is accounted for
+	const float fscale = std::max(1.f, ratio);
+	const float support = filter_support(filter)*fscale;
+	Contributions c;
+	c.taps = std::max(1, (int)ceilf(support*2)+2);
+	c.first.resize(out);
+	c.weights.assign((unsigned long)out*c.taps, 0.f);
+	for (int o=0; o<out; o++) {
+		const float center = (o+.5f)*ratio;
+		int first = std::max(0, (int)floorf(center-support));
+		int last  = std::min(in-1, (int)ceilf(center+support));
+		if (last-first+1>c.taps) last = first+c.taps-1;
+		float *w = c.weights.data()+(unsigned long)o*c.taps;
+		float sum = 0.f;
+		for (int i=first; i<=last; i++) {
+			w[i-first] = filter_weight(filter, (i+.5f-center)/fscale);
+			sum += w[i-first];
+		}
+		if (sum>0.f) {
+			for (int i=0; i<=last-first; i++) w[i] /= sum;
+		} else {
+			w[std::min(in-1, (int)center)-first] = 1.f;
+		}
+		c.first[o] = first;
+	}
+	return c;
+}
+
 bool TGAImage::scale(int w, int h) {
+	return resample(w, h, NEAREST);
+}
+
+bool TGAImage::resample(int w, int h, Filter filter) {
 	if (w<=0 || h<=0 || !data) return false;
-	unsigned char *tdata = new unsigned char[w*h*bytespp];
-	int nscanline = 0;
-	int oscanline = 0;
-	int erry = 0;
-	unsigned long nlinebytes = w*bytespp;
-	unsigned long olinebytes = width*bytespp;
-	for (int j=0; j<height; j++) {
-		int errx = width-w;
-		int nx   = -bytespp;
-		int ox   = -bytespp;
-		for (int i=0; i<width; i++) {
-			ox += bytespp;
-			errx += w;
-			while (errx>=(int)width) {
-				errx -= width;
-				nx += bytespp;
-				memcpy(tdata+nscanline+nx, data+oscanline+ox, bytespp);
+	const unsigned long nlinebytes = (unsigned long)w*bytespp;
+	const unsigned long olinebytes = (unsigned long)width*bytespp;
+	unsigned char *tdata = new unsigned char[(unsigned long)h*nlinebytes];
+
+	if (filter==NEAREST) {
+		std::vector<unsigned long> src(w);
+		for (int i=0; i<w; i++) src[i] = (unsigned long)((2ull*i+1)*width/(2ull*w))*bytespp; // pixel centers
+		parallel::forRows(h, [&](int begin, int end) {
+			for (int j=begin; j<end; j++) {
+				const unsigned long long oj = (2ull*j+1)*height/(2ull*h);
+				const unsigned char *oline = data+oj*olinebytes;
+				unsigned char *nline = tdata+j*nlinebytes;
+				if (j>begin && oj==(2ull*j-1)*height/(2ull*h)) {
+					memcpy(nline, nline-nlinebytes, nlinebytes);
+					continue;
+				}
+				for (int i=0; i<w; i++) memcpy(nline+i*bytespp, oline+src[i], bytespp);
 			}
-		}
-		erry += h;
-		oscanline += olinebytes;
-		while (erry>=(int)height) {
-			if (erry>=(int)height<<1) // it means we jump over a scanline
-				memcpy(tdata+nscanline+nlinebytes, tdata+nscanline, nlinebytes);
-			erry -= height;
-			nscanline += nlinebytes;
-		}
+		});
+	} else {
+		// separable: filter every line horizontally into floats, then combine whole lines vertically
+		const Contributions cx = contributions(width, w, filter);
+		const Contributions cy = contributions(height, h, filter);
+		std::vector<float> horizontal((unsigned long)height*nlinebytes);
+		parallel::forRows(height, [&](int begin, int end) {
+			for (int j=begin; j<end; j++) {
+				const unsigned char *oline = data+j*olinebytes;
+				float *hline = horizontal.data()+j*nlinebytes;
+				for (int i=0; i<w; i++) {
+					const float *weights = cx.weights.data()+(unsigned long)i*cx.taps;
+					const unsigned char *src = oline+(unsigned long)cx.first[i]*bytespp;
+					float acc[4] = {0.f, 0.f, 0.f, 0.f};
+					const int taps = std::min(cx.taps, width-cx.first[i]);
+					for (int k=0; k<taps; k++) {
+						for (int t=0; t<bytespp; t++) acc[t] += weights[k]*src[k*bytespp+t];
+					}
+					for (int t=0; t<bytespp; t++) hline[i*bytespp+t] = acc[t];
+				}
+			}
+		});
+		parallel::forRows(h, [&](int begin, int end) {
+			std::vector<float> acc(nlinebytes);
+			for (int j=begin; j<end; j++) {
+				std::fill(acc.begin(), acc.end(), 0.f);
+				const float *weights = cy.weights.data()+(unsigned long)j*cy.taps;
+				const int taps = std::min(cy.taps, height-cy.first[j]);
+				for (int k=0; k<taps; k++) {
+					const float wk = weights[k];
+					if (wk==0.f) continue;
+					const float *hline = horizontal.data()+(unsigned long)(cy.first[j]+k)*nlinebytes;
+					for (unsigned long b=0; b<nlinebytes; b++) acc[b] += wk*hline[b];
+				}
+				unsigned char *nline = tdata+j*nlinebytes;
+				for (unsigned long b=0; b<nlinebytes; b++) {
+					nline[b] = (unsigned char)std::min(255.f, std::max(0.f, acc[b]+.5f));
+				}
+			}
+		});
 	}
 	delete [] data;
 	data = tdata;
@@ -350,3 +466,41 @@ bool TGAImage::scale(int w, int h) {
 	return true;
 }
 
+// Each level is box filtered from the previous one down to 1x1, levels[0] is a copy of this image
+bool TGAImage::build_mipmaps(std::vector<TGAImage> &levels) const {
+	if (!data) return false;
+	levels.clear();
+	levels.push_back(*this);
+	while (levels.back().width>1 || levels.back().height>1) {
+		const TGAImage &prev = levels.back();
+		const int w = std::max(1, prev.width>>1);
+		const int h = std::max(1, prev.height>>1);
+		if ((prev.width&1) || (prev.height&1)) {
+			// odd sizes need the general filter to keep every texel
+			TGAImage next(prev);
+			next.resample(w, h, BOX);
+			levels.push_back(std::move(next));
+			continue;
+		}
+		TGAImage next(w, h, bytespp);
+		const unsigned long plinebytes = (unsigned long)prev.width*bytespp;
+		const unsigned long nlinebytes = (unsigned long)w*bytespp;
+		const unsigned char *pdata = prev.data;
+		unsigned char *ndata = next.data;
+		parallel::forRows(h, [&](int begin, int end) {
+			for (int j=begin; j<end; j++) {
+				const unsigned char *l0 = pdata+2*j*plinebytes;
+				const unsigned char *l1 = l0+plinebytes;
+				unsigned char *nline = ndata+j*nlinebytes;
+				for (int i=0; i<w; i++) {
+					for (int t=0; t<bytespp; t++) {
+						const unsigned long a = 2*i*bytespp+t;
+						nline[i*bytespp+t] = (l0[a]+l0[a+bytespp]+l1[a]+l1[a+bytespp]+2)>>2;
+					}
+				}
+			}
+		});
+		levels.push_back(std::move(next));
+	}
+	return true;
+}
@@ -2,6 +2,7 @@
 #define __IMAGE_H__
 
 #include <fstream>
+#include <vector>
 
 #pragma pack(push,1)
 struct TGA_Header {
@@ -22,6 +23,7 @@ struct TGA_Header {
 
 
 
+// 4 bytes in the order of the pixels in a TGA file, trivially copyable
 struct TGAColor {
 	union {
 		struct {
@@ -30,33 +32,19 @@ struct TGAColor {
 		unsigned char raw[4];
 		unsigned int val;
 	};
-	int bytespp;
-
-	TGAColor() : val(0), bytespp(1) {
-	}
-
-	TGAColor(unsigned char R, unsigned char G, unsigned char B, unsigned char A) : b(B), g(G), r(R), a(A), bytespp(4) {
-	}
 
-	TGAColor(int v, int bpp) : val(v), bytespp(bpp) {
+	TGAColor() : val(0) {
 	}
 
-	TGAColor(const TGAColor &c) : val(c.val), bytespp(c.bytespp) {
+	TGAColor(unsigned char R, unsigned char G, unsigned char B, unsigned char A) : b(B), g(G), r(R), a(A) {
 	}
 
-	TGAColor(const unsigned char *p, int bpp) : val(0), bytespp(bpp) {
+	// the channels a pixel of bpp bytes does not have are 0
+	TGAColor(const unsigned char *p, int bpp) : val(0) {
 		for (int i=0; i<bpp; i++) {
 			raw[i] = p[i];
 		}
 	}
-
-	TGAColor & operator =(const TGAColor &c) {
-		if (this != &c) {
-			bytespp = c.bytespp;
-			val = c.val;
-		}
-		return *this;
-	}
 };
 
 
@@ -68,24 +56,32 @@ protected:
 	int bytespp;
 
 	bool   load_rle_data(std::ifstream &in);
-	bool unload_rle_data(std::ofstream &out);
+	void unload_rle_data(std::vector<unsigned char> &out);
 public:
 	enum Format {
 		GRAYSCALE=1, RGB=3, RGBA=4
 	};
 
+	enum Filter {
+		NEAREST, BOX, BILINEAR, LANCZOS
+	};
+
 	TGAImage();
 	TGAImage(int w, int h, int bpp);
 	TGAImage(const TGAImage &img);
+	TGAImage(TGAImage &&img);
 	bool read_tga_file(const char *filename);
-	bool write_tga_file(const char *filename, bool rle=true);
+	bool write_tga_file(const char *filename, bool rle=true, int x_origin=0, int y_origin=0);
 	bool flip_horizontally();
 	bool flip_vertically();
 	bool scale(int w, int h);
+	bool resample(int w, int h, Filter filter=BILINEAR);
+	bool build_mipmaps(std::vector<TGAImage> &levels) const;
 	TGAColor get(int x, int y);
 	bool set(int x, int y, TGAColor c);
 	~TGAImage();
 	TGAImage & operator =(const TGAImage &img);
+	TGAImage & operator =(TGAImage &&img);
 	int get_width();
 	int get_height();
 	int get_bytespp();
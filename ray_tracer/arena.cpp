@@ -0,0 +1,89 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+namespace {
+
+std::atomic<size_t> peak{0};
+
+void recordPeak(size_t highWater) {
+    size_t seen = peak.load(std::memory_order_relaxed);
+    while (highWater > seen && !peak.compare_exchange_weak(seen, highWater, std::memory_order_relaxed)) {
+    }
+}
+
+size_t padding(const char *p, size_t alignment) { return (alignment - (reinterpret_cast<uintptr_t>(p) & (alignment - 1))) & (alignment - 1); }
+
+}   // namespace
+
+namespace arena {
+
+void *Arena::allocate(size_t bytes, size_t alignment) {
+    if (blocks.empty() || offset + padding(blocks[current].data.get() + offset, alignment) + bytes > blocks[current].size) {
+        nextBlock(bytes, alignment);
+    }
+    char *begin = blocks[current].data.get() + offset;
+    begin += padding(begin, alignment);
+    offset = begin + bytes - blocks[current].data.get();
+
+    used += bytes;
+    if (used > highWater) {
+        highWater = used;
+        recordPeak(highWater);
+    }
+    return begin;
+}
+
+void Arena::nextBlock(size_t bytes, size_t alignment) {
+    const size_t needed = bytes + alignment;
+    // reuse the blocks kept by rewind before asking the heap
+    size_t next = blocks.empty() ? 0 : current + 1;
+    while (next < blocks.size() && blocks[next].size < needed) {
+        next++;
+    }
+    if (next == blocks.size()) {
+        const size_t size = std::max(needed, blocks.empty() ? blockSize : blocks.back().size * 2);
+        blocks.push_back(Block{std::unique_ptr<char[]>{new char[size]}, size});
+    }
+    current = next;
+    offset  = 0;
+}
+
+void Arena::rewind(const Mark &m) {
+    current = m.block;
+    offset  = m.offset;
+    used    = m.used;
+}
+
+void Arena::reset() {
+    if (blocks.size() > 1) {
+        size_t total = 0;
+        for (const Block &block : blocks) {
+            total += block.size;
+        }
+        blocks.clear();
+        blocks.push_back(Block{std::unique_ptr<char[]>{new char[total]}, total});
+    }
+    current = 0;
+    offset  = 0;
+    used    = 0;
+}
+
+Stats Arena::stats() const {
+    Stats s{used, highWater, 0, blocks.size()};
+    for (const Block &block : blocks) {
+        s.capacity += block.size;
+    }
+    return s;
+}
+
+Arena &local() {
+    thread_local Arena arena{};
+    return arena;
+}
+
+size_t peakHighWater() { return peak.load(std::memory_order_relaxed); }
+
+}   // namespace arena
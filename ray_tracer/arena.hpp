@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+ * Transient render data lives in a per thread monotonic arena instead of the global heap.
+ * Allocation bumps a pointer, deallocation does nothing and rewinding to a mark releases
+ * everything allocated since, so the render loop never calls the global new once the arena is warm.
+ */
+namespace arena {
+
+struct Stats {
+    size_t used;        // bytes handed out since the last reset
+    size_t highWater;   // most bytes in use at any time
+    size_t capacity;    // bytes reserved from the heap
+    size_t blocks;
+};
+
+class Arena {
+  public:
+    // a position in the arena to rewind to
+    struct Mark {
+        size_t block;
+        size_t offset;
+        size_t used;
+    };
+
+    Arena(size_t blockSize = 64 * 1024) : blockSize{blockSize} {}
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t bytes, size_t alignment);
+
+    Mark mark() const { return Mark{current, offset, used}; }
+    // Everything allocated after m is released, the blocks are kept for reuse
+    void rewind(const Mark &m);
+    // Releases everything, merges the blocks into one large enough for the high water mark
+    void reset();
+
+    Stats stats() const;
+
+  private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void nextBlock(size_t bytes, size_t alignment);
+
+    size_t blockSize;
+    std::vector<Block> blocks{};
+    size_t current{0};   // block allocations come from
+    size_t offset{0};    // next free byte of the current block
+    size_t used{0};
+    size_t highWater{0};
+};
+
+/**
+ * The arena of the calling thread
+ */
+Arena &local();
+
+/**
+ * The largest high water mark any thread's arena reached
+ */
+size_t peakHighWater();
+
+/**
+ * Rewinds an arena to where it was when the scope was entered
+ */
+class Scope {
+  public:
+    Scope(Arena &arena) : arena{arena}, start{arena.mark()} {}
+    ~Scope() { arena.rewind(start); }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    Arena &arena;
+    Arena::Mark start;
+};
+
+/**
+ * Standard allocator drawing from an arena, deallocate is a no op
+ */
+template <typename T> class ArenaAllocator {
+  public:
+    using value_type = T;
+
+    ArenaAllocator(Arena &arena = local()) : arena{&arena} {}
+    template <typename U> ArenaAllocator(const ArenaAllocator<U> &other) : arena{other.arena} {}
+
+    T *allocate(size_t n) { return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T *, size_t) {}
+
+    template <typename U> bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+    template <typename U> bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+
+  private:
+    template <typename U> friend class ArenaAllocator;
+    Arena *arena;
+};
+
+template <typename T> using Vector = std::vector<T, ArenaAllocator<T>>;
+
+}   // namespace arena
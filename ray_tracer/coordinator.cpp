@@ -0,0 +1,151 @@
+#include "coordinator.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct Job {
+    output::Crop crop;
+    std::string path;
+    int attempts{0};
+};
+
+std::vector<std::string> split(const std::string &command) {
+    std::istringstream iss{command};
+    std::vector<std::string> words;
+    std::string word;
+    while (iss >> word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+pid_t launch(const std::vector<std::string> &words) {
+    const pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+    // the worker's progress output would interleave with ours
+    const int devNull = open("/dev/null", O_WRONLY);
+    if (devNull >= 0) {
+        dup2(devNull, STDOUT_FILENO);
+        close(devNull);
+    }
+    std::vector<char *> argv;
+    for (const std::string &word : words) {
+        argv.push_back(const_cast<char *>(word.c_str()));
+    }
+    argv.push_back(nullptr);
+    execvp(argv[0], argv.data());
+    _exit(127);
+}
+
+}   // namespace
+
+namespace coordinator {
+
+bool render(const std::string &executable, int canvasWidth, int canvasHeight, const Options &options, const std::string &path) {
+    const unsigned seed       = options.seed != 0 ? options.seed : std::random_device{}() | 1u;
+    const std::string workDir = options.workDir.empty() ? path + ".tiles" : options.workDir;
+    const int tileSize        = std::max(1, options.tileSize);
+    const int workers         = std::max(1, options.workers);
+    mkdir(workDir.c_str(), 0755);
+
+    std::deque<Job> pending;
+    std::vector<std::string> parts;
+    for (int y = 0; y < canvasHeight; y += tileSize) {
+        for (int x = 0; x < canvasWidth; x += tileSize) {
+            Job job;
+            job.crop = output::Crop{x, y, std::min(tileSize, canvasWidth - x), std::min(tileSize, canvasHeight - y), canvasWidth, canvasHeight};
+            job.path = workDir + "/tile_" + std::to_string(x) + "_" + std::to_string(y) + ".ppm";
+            parts.push_back(job.path);
+            pending.push_back(job);
+        }
+    }
+    std::cout << "Rendering " << pending.size() << " tiles on " << workers << " workers, seed " << seed << '\n';
+
+    std::map<pid_t, std::pair<Job, int>> running;   // worker pid -> job and slot
+    std::vector<bool> slotBusy(workers, false);
+    bool failed = false;
+    while (!pending.empty() || !running.empty()) {
+        // fill the free slots
+        for (int slot = 0; slot < workers && !pending.empty() && !failed; slot++) {
+            if (slotBusy[slot]) {
+                continue;
+            }
+            Job job = pending.front();
+            pending.pop_front();
+            std::vector<std::string> words;
+            if (!options.launchers.empty()) {
+                words = split(options.launchers[slot % options.launchers.size()]);
+            }
+            words.push_back(executable);
+            words.insert(words.end(), {"--seed", std::to_string(seed), "--out", job.path, "--crop", std::to_string(job.crop.x), std::to_string(job.crop.y),
+                                       std::to_string(job.crop.width), std::to_string(job.crop.height)});
+            if (options.resolution.size() == 2) {
+                words.insert(words.end(), {"--resolution", std::to_string(options.resolution[0]), std::to_string(options.resolution[1])});
+            }
+            words.insert(words.end(), options.renderArgs.begin(), options.renderArgs.end());
+            const pid_t pid = launch(words);
+            if (pid < 0) {
+                std::cerr << "can't start a worker" << '\n';
+                pending.push_front(job);
+                break;
+            }
+            slotBusy[slot] = true;
+            running.emplace(pid, std::make_pair(job, slot));
+        }
+        if (running.empty()) {
+            break;
+        }
+
+        int status;
+        const pid_t pid = wait(&status);
+        if (pid < 0) {
+            break;
+        }
+        auto it = running.find(pid);
+        if (it == running.end()) {
+            continue;
+        }
+        Job job = it->second.first;
+        slotBusy[it->second.second] = false;
+        running.erase(it);
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            continue;
+        }
+        if (++job.attempts > options.retries) {
+            std::cerr << "tile " << job.crop.x << ", " << job.crop.y << " failed " << job.attempts << " times" << '\n';
+            failed = true;
+        } else {
+            std::cerr << "tile " << job.crop.x << ", " << job.crop.y << " failed, retrying" << '\n';
+            pending.push_back(job);
+        }
+    }
+    if (failed || !pending.empty()) {
+        return false;
+    }
+
+    if (!output::stitch(parts, path)) {
+        return false;
+    }
+    for (const std::string &part : parts) {
+        std::remove(part.c_str());
+    }
+    rmdir(workDir.c_str());
+    return true;
+}
+
+}   // namespace coordinator
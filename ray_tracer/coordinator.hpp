@@ -0,0 +1,31 @@
+#pragma once
+
+#include "output.hpp"
+
+#include <string>
+#include <vector>
+
+namespace coordinator {
+
+struct Options {
+    int workers{4};      // processes running at the same time
+    int tileSize{512};   // tiles are tileSize x tileSize pixels, smaller on the canvas border
+    int retries{2};      // extra attempts of a tile whose worker failed
+    unsigned seed{0};    // scene seed passed to every worker, 0 picks one
+
+    std::vector<int> resolution{};          // canvas size passed to the workers, empty keeps their default
+    std::vector<std::string> renderArgs{};  // passed on to every worker, like --fast-math, all tiles need the same
+    std::vector<std::string> launchers{};   // command prefixes of the worker slots, e.g. "ssh node1", empty runs locally
+    std::string workDir{};                  // where the tiles go, must be shared with remote workers
+};
+
+/**
+ * Splits the canvas in tiles and renders each one in a separate process, running executable
+ * with --seed --crop --out, then stitches the tiles into path.
+ * Workers are started through the launchers in turn, so hosts that share the filesystem can take part.
+ * Every tile is a pure function of the seed, a failed tile is simply rendered again.
+ * @return false if a tile still failed after all retries or stitching failed
+ */
+bool render(const std::string &executable, int canvasWidth, int canvasHeight, const Options &options, const std::string &path);
+
+}   // namespace coordinator
@@ -0,0 +1,145 @@
+#include "fastmath.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Keeps the benchmark loops from being optimized away
+volatile float sink;
+
+template <typename F> double nanosecondsPerCall(int count, F &&f) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / std::max(count, 1);
+}
+
+// Restores the mode when a measurement is done
+struct ModeScope {
+    fastmath::Mode saved;
+    ModeScope(fastmath::Mode m) : saved{fastmath::mode} { fastmath::setMode(m); }
+    ~ModeScope() { fastmath::setMode(saved); }
+};
+
+}   // namespace
+
+namespace fastmath {
+
+void normalize(glm::vec3 *v, int count) {
+    if (!fast()) {
+        for (int i = 0; i < count; i++) {
+            v[i] = glm::normalize(v[i]);
+        }
+        return;
+    }
+    int i = 0;
+#ifdef FASTMATH_SSE
+    for (; i + 4 <= count; i += 4) {
+        const __m128 x     = _mm_set_ps(v[i + 3].x, v[i + 2].x, v[i + 1].x, v[i].x);
+        const __m128 y     = _mm_set_ps(v[i + 3].y, v[i + 2].y, v[i + 1].y, v[i].y);
+        const __m128 z     = _mm_set_ps(v[i + 3].z, v[i + 2].z, v[i + 1].z, v[i].z);
+        const __m128 dot   = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        const __m128 guess = _mm_rsqrt_ps(dot);
+        // one Newton step: y (1.5 - .5 d y^2), rounded in the order of approxRsqrt so both agree bit for bit
+        const __m128 refined = _mm_mul_ps(guess, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(.5f), dot), guess), guess)));
+        alignas(16) float scale[4];
+        _mm_store_ps(scale, refined);
+        for (int k = 0; k < 4; k++) {
+            v[i + k] *= scale[k];
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        v[i] = normalize(v[i]);
+    }
+}
+
+Accuracy measureAccuracy() {
+    ModeScope scope{Mode::Fast};
+    Accuracy accuracy{0.f, 0.f, 0.f};
+
+    // rsqrt over many binades
+    for (float x = 1e-20f; x < 1e20f; x *= 1.0137f) {
+        const double exact = 1.0 / std::sqrt((double) x);
+        accuracy.rsqrt     = std::max(accuracy.rsqrt, (float) std::abs((approxRsqrt(x) - exact) / exact));
+    }
+
+    // pow over the range of Phong terms
+    for (float x = 1e-4f; x <= 1.f; x += 1e-4f) {
+        for (float y : {.5f, 1.f, 2.f, 5.f, 10.f, 32.f, 100.f, 500.f}) {
+            const double exact = std::pow((double) x, (double) y);
+            if (exact > 1e-30) {
+                accuracy.pow = std::max(accuracy.pow, (float) std::abs((pow(x, y) - exact) / exact));
+            }
+        }
+    }
+
+    // normalize of random directions of all lengths, batched and one by one
+    std::mt19937 gen{1};
+    std::uniform_real_distribution<float> component{-1.f, 1.f};
+    std::uniform_real_distribution<float> scale{-10.f, 10.f};
+    std::vector<glm::vec3> vectors(4099);
+    for (glm::vec3 &v : vectors) {
+        v = glm::vec3{component(gen), component(gen), component(gen)} * std::exp2(scale(gen));
+    }
+    std::vector<glm::vec3> single = vectors;
+    normalize(vectors.data(), (int) vectors.size());
+    for (size_t i = 0; i < vectors.size(); i++) {
+        single[i]          = normalize(single[i]);
+        accuracy.normalize = std::max(accuracy.normalize, (float) std::abs(std::sqrt((double) glm::dot(vectors[i], vectors[i])) - 1.0));
+        accuracy.normalize = std::max(accuracy.normalize, (float) std::abs(std::sqrt((double) glm::dot(single[i], single[i])) - 1.0));
+    }
+    return accuracy;
+}
+
+Timing benchmarkNormalize(int count) {
+    std::vector<glm::vec3> input(count);
+    std::mt19937 gen{2};
+    std::uniform_real_distribution<float> component{-1.f, 1.f};
+    for (glm::vec3 &v : input) {
+        v = glm::vec3{component(gen), component(gen), component(gen)} + glm::vec3{2.f, 0.f, 0.f};
+    }
+
+    Timing timing{};
+    std::vector<glm::vec3> work = input;
+    {
+        ModeScope scope{Mode::Exact};
+        timing.exactNs = nanosecondsPerCall(count, [&] { normalize(work.data(), count); });
+    }
+    sink = work[count / 2].x;
+    work = input;
+    {
+        ModeScope scope{Mode::Fast};
+        timing.fastNs = nanosecondsPerCall(count, [&] { normalize(work.data(), count); });
+    }
+    sink = work[count / 2].x;
+    return timing;
+}
+
+Timing benchmarkPow(int count) {
+    std::vector<float> input(count);
+    std::mt19937 gen{3};
+    std::uniform_real_distribution<float> base{0.f, 1.f};
+    for (float &x : input) {
+        x = base(gen);
+    }
+
+    Timing timing{};
+    float sum = 0.f;
+    for (Mode m : {Mode::Exact, Mode::Fast}) {
+        ModeScope scope{m};
+        const double ns = nanosecondsPerCall(count, [&] {
+            for (float x : input) {
+                sum += pow(x, 32.f);
+            }
+        });
+        (m == Mode::Exact ? timing.exactNs : timing.fastNs) = ns;
+    }
+    sink = sum;
+    return timing;
+}
+
+}   // namespace fastmath
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/geometric.hpp>
+#include <glm/glm.hpp>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define FASTMATH_SSE 1
+#endif
+
+/**
+ * Math of the per ray hot path with selectable precision.
+ * Exact mode forwards to the standard library and glm.
+ * Fast mode uses approximations within the bounds of BOUNDS: 1e-6 relative error for rsqrt, 2e-4 for pow
+ * and 1e-6 deviation of a normalized length from 1. --math-report checks them.
+ * Building with -DRAY_FAST_MATH starts in fast mode, setMode switches at runtime.
+ */
+namespace fastmath {
+
+enum class Mode { Exact, Fast };
+
+#ifdef RAY_FAST_MATH
+inline Mode mode = Mode::Fast;
+#else
+inline Mode mode = Mode::Exact;
+#endif
+
+// Only switch while nothing renders, the mode is read without synchronisation
+inline void setMode(Mode m) { mode = m; }
+inline bool fast() { return mode == Mode::Fast; }
+
+inline uint32_t bits(float x) {
+    uint32_t b;
+    memcpy(&b, &x, sizeof(b));
+    return b;
+}
+
+inline float fromBits(uint32_t b) {
+    float x;
+    memcpy(&x, &b, sizeof(x));
+    return x;
+}
+
+/**
+ * 1 / sqrt(x) for x > 0: hardware estimate refined by a Newton step
+ */
+inline float approxRsqrt(float x) {
+#ifdef FASTMATH_SSE
+    const float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+    return y * (1.5f - .5f * x * y * y);
+#else
+    float y = fromBits(0x5f375a86u - (bits(x) >> 1));
+    y       = y * (1.5f - .5f * x * y * y);
+    return y * (1.5f - .5f * x * y * y);
+#endif
+}
+
+/**
+ * log2 for normal x > 0, the mantissa is folded into [sqrt(.5), sqrt(2)) and expanded in atanh
+ */
+inline float approxLog2(float x) {
+    // exponent relative to sqrt(.5), so the remaining mantissa lies in [sqrt(.5), sqrt(2)) without a branch
+    const uint32_t b   = bits(x);
+    const int exponent = (int) (b - 0x3f3504f3u) >> 23;
+    const float m      = fromBits(b - ((uint32_t) exponent << 23));
+    const float t  = (m - 1.f) / (m + 1.f);
+    const float t2 = t * t;
+    // 2 / ln(2) * (t + t^3 / 3 + t^5 / 5), |t| < .172
+    return exponent + t * (2.88539008f + t2 * (.961796694f + t2 * .577078016f));
+}
+
+/**
+ * 2^x, 0 below the normal range
+ */
+inline float approxExp2(float x) {
+    if (x < -126.f) {
+        return 0.f;
+    }
+    x = std::min(x, 127.f);
+    // adding 1.5 * 2^23 rounds to an integer in the low mantissa bits, no int to float conversion needed
+    const float shifted = x + 12582912.f;
+    const int n         = (int) (bits(shifted) - bits(12582912.f));
+    const float f       = x - (shifted - 12582912.f);   // [-.5, .5]
+    // least squares fit of 2^f on [-.5, .5], evaluated in pairs to keep the dependency chain short
+    const float f2 = f * f;
+    const float p  = (.999999191f + .693121968f * f) + f2 * ((.240249811f + .0559170392f * f) + f2 * .00956051021f);
+    return p * fromBits((uint32_t) (n + 127) << 23);
+}
+
+inline float rsqrt(float x) { return fast() ? approxRsqrt(x) : 1.f / std::sqrt(x); }
+
+inline float sqrt(float x) { return fast() ? (x > 0.f ? x * approxRsqrt(x) : 0.f) : std::sqrt(x); }
+
+/**
+ * x^y for x >= 0, like the Phong exponent
+ */
+inline float pow(float x, float y) {
+    if (!fast()) {
+        return powf(x, y);
+    }
+    if (x <= 0.f) {
+        return y == 0.f ? 1.f : 0.f;
+    }
+    return approxExp2(y * approxLog2(x));
+}
+
+inline float length(glm::vec3 v) { return fast() ? sqrt(glm::dot(v, v)) : glm::length(v); }
+
+inline glm::vec3 normalize(glm::vec3 v) { return fast() ? v * approxRsqrt(glm::dot(v, v)) : glm::normalize(v); }
+
+/**
+ * Normalizes count vectors in place, four at a time in fast mode, with the results of normalize
+ */
+void normalize(glm::vec3 *v, int count);
+
+struct Accuracy {
+    float rsqrt;       // largest relative error
+    float pow;         // largest relative error where x^y > 1e-30
+    float normalize;   // largest deviation of the length from 1
+
+    bool within(const Accuracy &bounds) const { return rsqrt <= bounds.rsqrt && pow <= bounds.pow && normalize <= bounds.normalize; }
+};
+
+// Documented accuracy of the fast mode
+const Accuracy BOUNDS{1e-6f, 2e-4f, 1e-6f};
+
+/**
+ * Largest errors of the fast mode approximations over a sweep of their domains
+ */
+Accuracy measureAccuracy();
+
+struct Timing {
+    double exactNs;   // per call
+    double fastNs;
+};
+
+/**
+ * Time per call of exact and fast mode for count calls of normalize and pow
+ */
+Timing benchmarkNormalize(int count);
+Timing benchmarkPow(int count);
+
+}   // namespace fastmath
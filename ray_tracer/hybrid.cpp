@@ -0,0 +1,90 @@
+#include "hybrid.hpp"
+
+#include "arena.hpp"
+#include "fastmath.hpp"
+#include "renderer.hpp"
+#include "screen.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace hybrid {
+
+VisibilityBuffer rasterize(const scenario::Scene &scene, int x, int y, int width, int height) {
+    const size_t count = (size_t) width * height;
+    VisibilityBuffer buffer{x, y, width, height, std::vector<int>(count, -1), std::vector<float>(count, std::numeric_limits<float>::infinity()),
+                            std::vector<glm::vec3>(count, glm::vec3{0.f})};
+
+    // camera rays are the same for every sphere
+    const screen::CameraRays rays{scene};
+    const glm::vec3 origin = scene.camera.getPosition();
+    std::vector<glm::vec3> directions(count);
+    std::vector<glm::vec3> unitDirections(count);
+    std::vector<float> lengths(count);
+    for (int j = 0; j < height; j++) {
+        for (int i = 0; i < width; i++) {
+            const size_t p = (size_t) j * width + i;
+            directions[p]  = rays(x + i, y + j);
+            lengths[p]     = fastmath::length(directions[p]);
+        }
+    }
+    unitDirections = directions;
+    fastmath::normalize(unitDirections.data(), (int) count);
+
+    // in scene order with <=, ties go to the later sphere like in intersectedSpheres
+    for (size_t s = 0; s < scene.spheres.size(); s++) {
+        const Sphere &sphere = scene.spheres[s];
+        screen::Bounds bounds;
+        if (!screen::bounds(scene, sphere, bounds)) {
+            continue;
+        }
+        const int minX = std::max(bounds.minX, x);
+        const int minY = std::max(bounds.minY, y);
+        const int maxX = std::min(bounds.maxX, x + width - 1);
+        const int maxY = std::min(bounds.maxY, y + height - 1);
+        for (int j = minY; j <= maxY; j++) {
+            for (int i = minX; i <= maxX; i++) {
+                const size_t p = (size_t) (j - y) * width + i - x;
+                float depth;
+                if (intersectSphere(origin, directions[p], unitDirections[p], lengths[p], sphere, depth) && depth <= buffer.depth[p]) {
+                    buffer.depth[p] = depth;
+                    buffer.id[p]    = (int) s;
+                }
+            }
+        }
+    }
+
+    for (size_t p = 0; p < count; p++) {
+        if (buffer.id[p] >= 0) {
+            buffer.point[p] = buffer.depth[p] * unitDirections[p] + origin;
+        }
+    }
+    return buffer;
+}
+
+void render(const scenario::Scene &scene, output::Tile &tile) {
+    const VisibilityBuffer visible = rasterize(scene, tile.x, tile.y, tile.width, tile.height);
+    const screen::CameraRays rays{scene};
+
+    tile.pixels.clear();
+    tile.pixels.reserve(tile.width * tile.height);
+
+    // reflections take their hit lists from the arena of this thread, released after every pixel
+    arena::Arena &transient = arena::local();
+    transient.reset();
+
+    for (int j = 0; j < tile.height; j++) {
+        for (int i = 0; i < tile.width; i++) {
+            arena::Scope pixel{transient};
+            const size_t p = (size_t) j * tile.width + i;
+            if (visible.id[p] < 0) {
+                tile.pixels.push_back(scene.backColor);
+                continue;
+            }
+            tile.pixels.push_back(traceReflections(scene, visible.point[p], rays(tile.x + i, tile.y + j), scene.spheres[visible.id[p]]));
+        }
+    }
+}
+
+}   // namespace hybrid
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "object.hpp"
+#include "output.hpp"
+#include "scene.hpp"
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Hybrid rendering: primary visibility is rasterized, only shadows and reflections are ray traced.
+ * Spheres are drawn as impostors: every sphere covers the pixels of its screen bounds and each of those
+ * runs the exact ray sphere test of the ray tracer against just that sphere, closest depth wins.
+ * The visible point of every pixel is the one full ray tracing finds, so the images are identical.
+ */
+namespace hybrid {
+
+/**
+ * What the camera sees in a region of the canvas, row major
+ */
+struct VisibilityBuffer {
+    int x;
+    int y;
+    int width;
+    int height;
+    std::vector<int> id;            // index into scene.spheres, -1 where the background shows
+    std::vector<float> depth;       // distance along the unit camera ray
+    std::vector<glm::vec3> point;   // world position of the visible point, the shading derives the normal from it
+};
+
+/**
+ * Rasterizes the sphere impostors of the region x, y, width, height of the canvas
+ */
+VisibilityBuffer rasterize(const scenario::Scene &scene, int x, int y, int width, int height);
+
+/**
+ * renderScene with rasterized primary visibility: the same pixels, only secondary rays are traced
+ */
+void render(const scenario::Scene &scene, output::Tile &tile);
+
+}   // namespace hybrid
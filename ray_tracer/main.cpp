@@ -1,166 +1,28 @@
+#include "arena.hpp"
+#include "coordinator.hpp"
+#include "fastmath.hpp"
+#include "hybrid.hpp"
 #include "material.hpp"
-#include "object.hpp"
+#include "output.hpp"
+#include "pathtracer.hpp"
+#include "post.hpp"
+#include "renderer.hpp"
 #include "scene.hpp"
+#include "server.hpp"
 
 #include <cmath>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <glm/geometric.hpp>
 #include <iostream>
 #include <limits>
+#include <string>
 #include <vector>
 
 #include <glm/glm.hpp>
 
-/**
- * Returns all the spheres that lie in the line formed by the vector vec
- * @param closest should be initialized as 0
- */
-std::vector<Sphere> intersectedSpheres(glm::vec3 origin, glm::vec3 direction, std::vector<Sphere> spheres, std::vector<glm::vec3> &intersectedPoints, int &closest) {
-    std::vector<Sphere> intersectedSpheres{};
-    // Calculate everything with the origin as 0 0 0
-
-    float closestLength = std::numeric_limits<float>::infinity();
-    int iterIndex       = 0; // position of the closest point in intersectedPoints
-    for (Sphere sphere : spheres) {
-        glm::vec3 point = sphere.getPosition() - origin;
-        // check if the sphere is behind the direction: discard
-        if (glm::dot(direction, point) <= 0) {
-            continue;
-        }
-        glm::vec3 projectedVector = glm::dot(direction, point) / glm::length(direction) * glm::normalize(direction);
-        if (glm::distance(point, projectedVector) <= sphere.getRadius()) {
-
-            intersectedSpheres.push_back(sphere);
-
-            // calculate point that is closest to camera and on the intersected
-            // sphere
-            float length = glm::length(projectedVector) - sqrt(powf(sphere.getRadius(), 2) - powf(glm::length(projectedVector - point), 2));
-            // Use this length to keep the index of the point that is the
-            // overall closest to the camera
-            if (length <= closestLength) {
-                closest = iterIndex;   // the closest point index is the index
-                                       // of the sphere that will now be added
-                                       // to the sphere interesctions
-                closestLength = length;
-            }
-            glm::vec3 intersectPoint = length * glm::normalize(direction) + origin;   // Convert the intersectionpoint to a global position
-            intersectedPoints.push_back(intersectPoint);
-            iterIndex++;
-        }
-    }
-    return intersectedSpheres;
-}
-
-glm::vec3 calculateColor(const scenario::Scene& scene, glm::vec3 point, glm::vec3 direction, Sphere sphere) {
-    // calculate light
-    glm::vec3 ambientLight  = scene.ambientLight * sphere.getMaterial().ambientConstant;
-    glm::vec3 diffuseLight  = glm::vec3{.0f};
-    glm::vec3 specularLight = glm::vec3{0.f};
-    for (scenario::PointLight light : scene.lights) {
-        // If blocked by another sphere: skip, this is shadow
-        int _c = 0;
-        std::vector<glm::vec3> _intersectedPoints{};
-        if (intersectedSpheres(point, light.position - point, scene.spheres, _intersectedPoints, _c).size() > 0) {
-            continue;
-        }
-
-        glm::vec3 lightDir     = glm::normalize(light.position - point);
-        glm::vec3 normalVector = glm::normalize(point - sphere.getPosition());
-
-        // Diffuse reflection
-        diffuseLight += sphere.getMaterial().diffuseConstant * light.diffusionIntensity * std::max(0.f, glm::dot(normalVector, lightDir));
-
-        // Specular reflection
-        glm::vec3 lightBounceDir = 2 * glm::dot(lightDir, normalVector) * normalVector - lightDir;
-        specularLight +=
-            sphere.getMaterial().specularConstant * light.specularIntensity * powf(std::max(0.f, glm::dot(-(direction + scene.camera.getPosition()), lightBounceDir)), sphere.getMaterial().shineFactor);
-    }
-    return ambientLight + diffuseLight + specularLight;
-}
-
-void renderScene(const scenario::Scene& scene, std::vector<std::vector<float>> &buffer) {
-    // Precalc
-    const std::vector<int> resolution = scene.canvas.getResolution();
-    const int width                   = resolution[0];
-    const int height                  = resolution[1];
-    const float viewPortWidth         = scene.viewPort.getRUP()[0] - scene.viewPort.getLDP()[0];
-    const float viewPortHeight        = -scene.viewPort.getRUP()[1] + scene.viewPort.getLDP()[1];
-    const float pixelWidth            = viewPortWidth / resolution[0];
-    const float pixelHeight           = viewPortHeight / resolution[1];
-
-    // Iterate over every pixel
-    for (size_t j = 0; j < height; j++) {
-        for (size_t i = 0; i < width; i++) {
-            glm::vec3 color {0.f};
-
-            std::vector<glm::vec3> intersectedPoints{};
-            int closest = 0;
-
-            glm::vec3 direction =
-                glm::vec3{pixelWidth * i - viewPortWidth / 2 + pixelWidth / 2, pixelHeight * j - viewPortHeight / 2 + pixelHeight / 2, scene.viewPort.getZ()};   // this is relative to the camera
-            std::vector<Sphere> intersected = intersectedSpheres(scene.camera.getPosition(), direction, scene.spheres, intersectedPoints, closest);
-
-            if (intersected.size() > 0) {
-                // This should get refactored
-
-                // Keep the point on the sphere we are calculating the color of
-                glm::vec3 point = intersectedPoints[closest];
-                Sphere sphere = intersected[closest];
-                // The total fraction of all combined colors is 1
-                float fraction = 1.f;
-                for (int i = 0; i < scene.reflectionCount; i ++) {
-                    color += calculateColor(scene, point, direction, sphere)*(1-sphere.getMaterial().reflectionFraction)*fraction;
-                    // the remaining fraction of color:
-                    fraction = fraction*sphere.getMaterial().reflectionFraction;
-
-                    // If there is no more reflection, break loop
-                    if (fraction <= 0) {
-                        break;
-                    }
-
-                    // caclulate new point, direction and sphere
-                    std::vector<glm::vec3> points{};
-                    glm::vec3 normalVector = glm::normalize(point - sphere.getPosition());
-                    direction = 2*glm::dot(-glm::normalize(direction), normalVector)*normalVector + glm::normalize(direction);
-                    std::vector<Sphere> spheres = intersectedSpheres(point, direction, scene.spheres, points, closest);
-
-                    // If there is no collision, return background color
-                    if (spheres.empty()) {
-                        color += scene.backColor*fraction*(sphere.getMaterial().reflectionFraction);
-                        break;
-                    }
-
-                    // set point and sphere
-                    point = points[closest];
-                    sphere = spheres[closest];
-                }
-            } else {
-                color = scene.backColor;
-            }
-
-            std::vector<float> colorWritable{};
-            for (int i = 0; i < 3; i++) {
-                colorWritable.push_back(color[i]);
-            }
-
-            buffer.push_back(colorWritable);
-        }
-    }
-}
-
-void render(int width, int height, std::vector<std::vector<float>> &framebuffer) {
-
-    std::ofstream ofs;   // save the framebuffer to file
-    ofs.open("./out.ppm");
-    ofs << "P6\n" << width << " " << height << "\n255\n";
-    for (size_t i = 0; i < height * width; ++i) {
-        for (size_t j = 0; j < 3; j++) {
-            ofs << (char) (255 * std::max(0.f, std::min(1.f, framebuffer[i][j])));
-        }
-    }
-    ofs.close();
-}
-
 void configureSettings(Settings &settings) {
     // Hardcoded predefined spheres and lights
     // SphereDefinition sphere{{-1.0f, -0.5f, 5.0f}, 1.f, MaterialBuilder::getMaterialProperties("mat1")};
@@ -173,17 +35,186 @@ void configureSettings(Settings &settings) {
     settings.preDefinedLights = {pointLight};
 }
 
-int main() {
+int main(int argc, char **argv) {
     // Load settings
     Settings settings{};
     material::loadMaterials();
 
     configureSettings(settings);
 
+    bool serve = false;
+    std::vector<int> crop{};   // x y width height
+    std::string outPath{"./out.ppm"};
+    bool distribute = false;
+    coordinator::Options jobs{};
+    bool pathTracing = false;
+    bool hybridMode  = false;
+    pathtracer::Options pathOptions{};
+    post::Options postOptions{};
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--serve")) {
+            serve = true;
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            settings.seed = (unsigned) std::stoul(argv[++i]);
+        } else if (!strcmp(argv[i], "--crop") && i + 4 < argc) {
+            for (int k = 0; k < 4; k++) {
+                crop.push_back(atoi(argv[++i]));
+            }
+        } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (!strcmp(argv[i], "--resolution") && i + 2 < argc) {
+            settings.resolution = {atoi(argv[i + 1]), atoi(argv[i + 2])};
+            jobs.resolution     = settings.resolution;
+            i += 2;
+        } else if (!strcmp(argv[i], "--distribute") && i + 1 < argc) {
+            distribute   = true;
+            jobs.workers = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--tile") && i + 1 < argc) {
+            jobs.tileSize = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--retries") && i + 1 < argc) {
+            jobs.retries = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--launch") && i + 1 < argc) {
+            jobs.launchers.push_back(argv[++i]);
+        } else if (!strcmp(argv[i], "--fast-math")) {
+            fastmath::setMode(fastmath::Mode::Fast);
+            jobs.renderArgs.push_back(argv[i]);
+        } else if (!strcmp(argv[i], "--path") && i + 1 < argc) {
+            pathTracing         = true;
+            pathOptions.samples = atoi(argv[i + 1]);
+            jobs.renderArgs.insert(jobs.renderArgs.end(), {argv[i], argv[i + 1]});
+            i++;
+        } else if (!strcmp(argv[i], "--bounces") && i + 1 < argc) {
+            pathOptions.bounces = atoi(argv[i + 1]);
+            jobs.renderArgs.insert(jobs.renderArgs.end(), {argv[i], argv[i + 1]});
+            i++;
+        } else if (!strcmp(argv[i], "--area-light") && i + 2 < argc) {
+            // --area-light sphere radius | --area-light rect width depth: the point lights become area lights around their position
+            const bool sphere = !strcmp(argv[i + 1], "sphere");
+            const int count   = sphere ? 3 : 4;
+            if ((!sphere && strcmp(argv[i + 1], "rect")) || i + count - 1 >= argc) {
+                std::cerr << "usage: --area-light sphere radius | --area-light rect width depth" << '\n';
+                return 1;
+            }
+            const float width = (float) atof(argv[i + 2]);
+            const float depth = sphere ? width : (float) atof(argv[i + 3]);
+            for (const LightDefinition &light : settings.preDefinedLights) {
+                const glm::vec3 corner = light.position - glm::vec3{width, 0.f, depth} * .5f;
+                settings.preDefinedAreaLights.push_back({sphere, sphere ? light.position : corner, width, glm::vec3{width, 0.f, 0.f}, glm::vec3{0.f, 0.f, depth},
+                                                         light.diffusionIntensity, light.specularIntensity});
+            }
+            settings.preDefinedLights.clear();
+            jobs.renderArgs.insert(jobs.renderArgs.end(), argv + i, argv + i + count);
+            i += count - 1;
+        } else if (!strcmp(argv[i], "--shadow-samples") && i + 2 < argc) {
+            settings.areaLightProbes  = atoi(argv[i + 1]);
+            settings.areaLightSamples = atoi(argv[i + 2]);
+            if (settings.areaLightProbes < 1 || settings.areaLightSamples < settings.areaLightProbes) {
+                std::cerr << "--shadow-samples probes samples needs 1 <= probes <= samples" << '\n';
+                return 1;
+            }
+            jobs.renderArgs.insert(jobs.renderArgs.end(), argv + i, argv + i + 3);
+            i += 2;
+        } else if (!strcmp(argv[i], "--reflections") && i + 1 < argc) {
+            settings.reflectionCount = atoi(argv[i + 1]);
+            jobs.renderArgs.insert(jobs.renderArgs.end(), {argv[i], argv[i + 1]});
+            i++;
+        } else if (!strcmp(argv[i], "--roulette") && i + 1 < argc) {
+            // 0 traces every reflection and refraction chain to the cap
+            settings.rouletteThreshold = (float) atof(argv[i + 1]);
+            jobs.renderArgs.insert(jobs.renderArgs.end(), {argv[i], argv[i + 1]});
+            i++;
+        } else if (!strcmp(argv[i], "--hybrid")) {
+            // rasterized primary visibility, the image doesn't change
+            hybridMode = true;
+            jobs.renderArgs.push_back(argv[i]);
+        } else if (!strcmp(argv[i], "--no-denoise")) {
+            pathOptions.denoise = false;
+            jobs.renderArgs.push_back(argv[i]);
+        } else if (!strcmp(argv[i], "--exposure") && i + 1 < argc) {
+            postOptions.exposure = (float) atof(argv[i + 1]);
+            jobs.renderArgs.insert(jobs.renderArgs.end(), {argv[i], argv[i + 1]});
+            i++;
+        } else if (!strcmp(argv[i], "--tonemap") && i + 1 < argc) {
+            const std::string name = argv[i + 1];
+            if (name != "clamp" && name != "reinhard" && name != "aces") {
+                std::cerr << "unknown tone map " << name << ", use clamp, reinhard or aces" << '\n';
+                return 1;
+            }
+            postOptions.toneMap = name == "reinhard" ? post::ToneMap::REINHARD : name == "aces" ? post::ToneMap::ACES : post::ToneMap::CLAMP;
+            jobs.renderArgs.insert(jobs.renderArgs.end(), {argv[i], argv[i + 1]});
+            i++;
+        } else if (!strcmp(argv[i], "--srgb")) {
+            postOptions.srgb = true;
+            jobs.renderArgs.push_back(argv[i]);
+        } else if (!strcmp(argv[i], "--dither")) {
+            postOptions.dither = true;
+            jobs.renderArgs.push_back(argv[i]);
+        } else if (!strcmp(argv[i], "--supersample") && i + 1 < argc) {
+            // resolution and crop stay in output pixels, every pixel is traced factor x factor times
+            postOptions.downsample = std::max(1, atoi(argv[i + 1]));
+            jobs.renderArgs.insert(jobs.renderArgs.end(), {argv[i], argv[i + 1]});
+            i++;
+        } else if (!strcmp(argv[i], "--math-report")) {
+            // accuracy of the fast mode and its speed against the exact glm path, fails outside of fastmath::BOUNDS
+            const fastmath::Accuracy accuracy = fastmath::measureAccuracy();
+            const fastmath::Timing normalize  = fastmath::benchmarkNormalize(1 << 20);
+            const fastmath::Timing pow        = fastmath::benchmarkPow(1 << 20);
+            std::cout << "max relative error rsqrt: " << accuracy.rsqrt << " pow: " << accuracy.pow << " normalized length error: " << accuracy.normalize << '\n';
+            std::cout << "normalize ns exact: " << normalize.exactNs << " fast: " << normalize.fastNs << '\n';
+            std::cout << "pow ns exact: " << pow.exactNs << " fast: " << pow.fastNs << '\n';
+            if (!accuracy.within(fastmath::BOUNDS)) {
+                std::cerr << "fast math outside of its bounds, rsqrt: " << fastmath::BOUNDS.rsqrt << " pow: " << fastmath::BOUNDS.pow << " normalize: " << fastmath::BOUNDS.normalize << '\n';
+                return 1;
+            }
+            return 0;
+        } else if (!strcmp(argv[i], "--stitch") && i + 2 < argc) {
+            // --stitch out.ppm part.ppm... joins crops rendered with the same seed
+            return output::stitch(std::vector<std::string>(argv + i + 2, argv + argc), argv[i + 1]) ? 0 : 1;
+        }
+    }
+
+    // the coordinator only hands out tiles, every worker builds the same scene from the seed
+    if (distribute) {
+        char executable[PATH_MAX];
+        if (!realpath("/proc/self/exe", executable)) {
+            std::cerr << "can't find the path of this executable" << '\n';
+            return 1;
+        }
+        jobs.seed = settings.seed;
+        return coordinator::render(executable, settings.resolution[0], settings.resolution[1], jobs, outPath) ? 0 : 1;
+    }
+
+    // the canvas is traced at the supersampled resolution, the post pass averages it back down
+    settings.tileRows = std::max(1, settings.tileRows);
+    const int factor = serve ? 1 : postOptions.downsample;
+    if (factor > 1) {
+        settings.resolution = {settings.resolution[0] * factor, settings.resolution[1] * factor};
+        settings.tileRows   = std::max(1, settings.tileRows / factor) * factor;
+    }
+
     scenario::Scene scene {settings};
 
-    // buffer for writing scene to file
-    std::vector<std::vector<float>> framebuffer{};
+    // stdout carries the protocol, the scene stays resident between requests
+    if (serve) {
+        server::Server server{scene};
+        server.run(std::cin, std::cout);
+        return 0;
+    }
+
+    const int width  = scene.canvas.getResolution()[0];
+    const int height = scene.canvas.getResolution()[1];
+
+    // only the pixels of the crop window are traced, each gets the value it has in the full image
+    output::Crop window = output::Crop::full(width / factor, height / factor);
+    if (!crop.empty()) {
+        window = output::Crop{crop[0], crop[1], crop[2], crop[3], width / factor, height / factor};
+        if (window.x < 0 || window.y < 0 || window.width <= 0 || window.height <= 0 || window.x + window.width > window.canvasWidth || window.y + window.height > window.canvasHeight) {
+            std::cerr << "crop window outside the canvas" << '\n';
+            return 1;
+        }
+    }
+    // the writer takes output pixels, the tiles are rendered in canvas pixels
+    const output::Crop traced{window.x * factor, window.y * factor, window.width * factor, window.height * factor, width, height};
 
     // debug info
     if (settings.debug) {
@@ -191,14 +222,34 @@ int main() {
         std::cout << "Rendering: " << '\n';
         std::cout << '\t' << "Spheres #: " << scene.spheres.size() << '\n';
         std::cout << '\t' << "Lights #: " << scene.lights.size() << '\n';
+        std::cout << '\t' << "Area lights #: " << scene.areaLights.size() << '\n';
     }
 
-    renderScene(scene, framebuffer);
+    // Bands of rows are written by the writer thread while the next band renders
+    output::ImageWriter writer{outPath, window, (size_t) settings.writerQueueSize, postOptions};
+    if (pathTracing) {
+        // the denoiser needs the whole window at once
+        output::Tile tile{traced.x, traced.y, traced.width, traced.height};
+        pathtracer::render(scene, tile, pathOptions);
+        writer.submit(std::move(tile));
+    }
+    for (int row = traced.y; !pathTracing && row < traced.y + traced.height; row += settings.tileRows) {
+        output::Tile tile{traced.x, row, traced.width, std::min(settings.tileRows, traced.y + traced.height - row)};
+        if (hybridMode) {
+            hybrid::render(scene, tile);
+        } else {
+            renderScene(scene, tile);
+        }
+        writer.submit(std::move(tile));
+    }
     if (settings.debug) {
         std::cout << "Scene succesfully rendered." << '\n';
-        std::cout << "Writing " << framebuffer.size() << " pixels." << '\n';
+        std::cout << "Writing " << window.width * window.height << " pixels from " << traced.width * traced.height << " traced." << '\n';
+        std::cout << "Arena high water: " << arena::peakHighWater() << " bytes." << '\n';
+    }
+    if (!writer.finish()) {
+        return 1;
     }
-    render(scene.canvas.getResolution()[0], scene.canvas.getResolution()[1], framebuffer);
 
     return 0;
 }
@@ -25,6 +25,21 @@ void loadMaterials() {
     addMaterial({"random_color", {1.f, 1.f, 1.f}, {0.5f, 0.6f, 0.3f}, glm::vec3{-0.5f}, 2.f, 0.0f});
     addMaterial({"mirror", {1.f, 1.f, 1.f}, {1.f, 1.f, 1.f}, glm::vec3{1.f}, 0.9f, .9f});
     addMaterial({"random_color_mirror", {1.f, 1.f, 1.f}, {0.9f, 0.9f, 0.9f}, glm::vec3{-0.5f}, 20.f, 0.1f});
+    addMaterial({"glass", {1.f, 1.f, 1.f}, {0.05f, 0.05f, 0.05f}, glm::vec3{0.05f}, 100.f, 0.f, 0.9f, 1.5f});
+}
+
+unsigned classify(const Material &material) {
+    unsigned features = 0;
+    if (material.specularConstant != glm::vec3{0.f}) {
+        features |= SPECULAR;
+    }
+    if (material.reflectionFraction > 0.f) {
+        features |= REFLECTIVE;
+    }
+    if (material.transmission > 0.f) {
+        features |= TRANSMISSIVE;
+    }
+    return features;
 }
 
 std::vector<std::string> getMaterialNames() {
@@ -2,11 +2,20 @@
 
 #include <glm/glm.hpp>
 
+#include <cmath>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 namespace material {
+
+// Material classes, the shading kernels leave out what a material doesn't have
+enum Features : unsigned {
+    SPECULAR     = 1,   // non zero specular constant
+    REFLECTIVE   = 2,   // non zero reflection fraction
+    TRANSMISSIVE = 4,   // non zero transmission
+};
+
 struct Material {
     std::string name;
     glm::vec3 specularConstant;
@@ -14,8 +23,38 @@ struct Material {
     glm::vec3 ambientConstant;
     float shineFactor;
     float reflectionFraction; // 1.f will be a perfect mirror
+    float transmission{0.f};   // share that enters the material, split between reflection and refraction by the Fresnel term
+    float refractiveIndex{1.f};
 };
 
+/**
+ * Schlick's approximation of the Fresnel reflectance of a dielectric
+ * @param cosine of the angle to the normal on the side of the thinner medium
+ */
+inline float schlick(float cosine, float refractiveIndex) {
+    float r0 = (1.f - refractiveIndex) / (1.f + refractiveIndex);
+    r0 *= r0;
+    const float m = 1.f - cosine;
+    return r0 + (1.f - r0) * m * m * m * m * m;
+}
+
+/**
+ * Snell's law for a unit direction hitting a surface with unit normal facing against it
+ * @param eta refractive index of the side the direction comes from over that of the other side
+ * @return false on total internal reflection
+ */
+inline bool refract(glm::vec3 direction, glm::vec3 normal, float eta, glm::vec3 &refracted) {
+    const float cosine = -glm::dot(direction, normal);
+    const float k      = 1.f - eta * eta * (1.f - cosine * cosine);
+    if (k < 0.f) {
+        return false;
+    }
+    refracted = eta * direction + (eta * cosine - std::sqrt(k)) * normal;
+    return true;
+}
+
+    unsigned classify(const Material &material);
+
     void loadMaterials();
 
     void addMaterial(Material material);
@@ -10,13 +10,17 @@ class Sphere {
     ~Sphere(){};
 
     glm::vec3 getPosition() const { return this->position; }
+    void setPosition(glm::vec3 position) { this->position = position; }
     float getRadius() const { return this->radius; }
 
-    material::Material getMaterial() const {return this->material;}
+    const material::Material &getMaterial() const { return this->material; }
+    // material::Features of the material, classified once when the sphere is built
+    unsigned getFeatures() const { return this->features; }
 
   private:
     glm::vec3 position;
     float radius;
 
     material::Material material;
+    unsigned features;
 };
@@ -0,0 +1,177 @@
+#include "output.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+namespace output {
+
+void quantize(const glm::vec3 *src, int count, char *dst) {
+    for (int i = 0; i < count; i++) {
+        for (int c = 0; c < 3; c++) {
+            dst[i * 3 + c] = (char) (255 * std::max(0.f, std::min(1.f, src[i][c])));
+        }
+    }
+}
+
+ImageWriter::ImageWriter(const std::string &path, int width, int height, size_t queueSize) : ImageWriter(path, Crop::full(width, height), queueSize) {}
+
+ImageWriter::ImageWriter(const std::string &path, const Crop &crop, size_t queueSize, const post::Options &post) : crop{crop}, post{post}, queue{queueSize} {
+    ofs.open(path, std::ios::binary);
+    ofs << "P6\n";
+    if (!crop.isFull()) {
+        ofs << "# crop " << crop.x << " " << crop.y << " " << crop.canvasWidth << " " << crop.canvasHeight << "\n";
+    }
+    ofs << crop.width << " " << crop.height << "\n255\n";
+    dataOffset = ofs.tellp();
+    if (!ofs.good()) {
+        std::cerr << "can't open file " << path << '\n';
+        failed = true;
+    }
+    worker = std::thread{&ImageWriter::run, this};
+}
+
+ImageWriter::~ImageWriter() { finish(); }
+
+void ImageWriter::submit(Tile tile) { queue.push(std::move(tile)); }
+
+bool ImageWriter::finish() {
+    if (worker.joinable()) {
+        queue.close();
+        worker.join();
+        ofs.close();
+    }
+    return !failed;
+}
+
+void ImageWriter::run() {
+    Tile tile{};
+    while (queue.pop(tile)) {
+        if (!failed) {
+            writeTile(tile);
+        }
+    }
+}
+
+void ImageWriter::writeTile(const Tile &tile) {
+    const int factor = std::max(1, post.downsample);
+    const int x      = tile.x / factor;
+    const int y      = tile.y / factor;
+    const int width  = tile.width / factor;
+    const int height = tile.height / factor;
+    std::vector<unsigned char> rgb((size_t) width * height * 3);
+    post::process(tile.pixels.data(), width, height, x, y, post, rgb.data());
+    for (int j = 0; j < height; j++) {
+        ofs.seekp(dataOffset + (std::streamoff(y - crop.y + j) * crop.width + x - crop.x) * 3);
+        ofs.write((const char *) rgb.data() + (size_t) j * width * 3, width * 3);
+    }
+    if (!ofs.good()) {
+        std::cerr << "can't write tile at " << tile.x << ", " << tile.y << '\n';
+        failed = true;
+    }
+}
+
+namespace {
+
+// Reads the header of a cropped ppm, leaves the stream at the pixel data
+bool readCropHeader(std::ifstream &in, Crop &crop) {
+    std::string magic;
+    std::string line;
+    in >> magic;
+    std::getline(in, line);
+    bool hasCrop = false;
+    while (in.peek() == '#') {
+        std::getline(in, line);
+        std::istringstream comment{line};
+        std::string hash, keyword;
+        comment >> hash >> keyword;
+        if (keyword == "crop") {
+            hasCrop = (bool) (comment >> crop.x >> crop.y >> crop.canvasWidth >> crop.canvasHeight);
+        }
+    }
+    int maxValue;
+    in >> crop.width >> crop.height >> maxValue;
+    in.get();
+    return in.good() && magic == "P6" && maxValue == 255 && hasCrop;
+}
+
+}   // namespace
+
+bool stitch(const std::vector<std::string> &parts, const std::string &path) {
+    std::unique_ptr<ImageWriter> writer;
+    Crop canvas{};
+    std::vector<bool> covered;   // one flag per canvas pixel
+    for (const std::string &part : parts) {
+        std::ifstream in{part, std::ios::binary};
+        Crop crop{};
+        if (!readCropHeader(in, crop)) {
+            std::cerr << "not a cropped ppm: " << part << '\n';
+            return false;
+        }
+        if (!writer) {
+            canvas = Crop::full(crop.canvasWidth, crop.canvasHeight);
+            covered.assign((size_t) canvas.width * canvas.height, false);
+            writer.reset(new ImageWriter{path, canvas});
+        }
+        if (crop.canvasWidth != canvas.canvasWidth || crop.canvasHeight != canvas.canvasHeight) {
+            std::cerr << "different canvas size: " << part << '\n';
+            return false;
+        }
+        if (crop.x < 0 || crop.y < 0 || crop.x + crop.width > crop.canvasWidth || crop.y + crop.height > crop.canvasHeight) {
+            std::cerr << "crop outside its canvas: " << part << '\n';
+            return false;
+        }
+        for (int y = crop.y; y < crop.y + crop.height; y++) {
+            for (int x = crop.x; x < crop.x + crop.width; x++) {
+                if (covered[(size_t) y * canvas.width + x]) {
+                    std::cerr << "overlaps an earlier part at " << x << ", " << y << ": " << part << '\n';
+                    return false;
+                }
+                covered[(size_t) y * canvas.width + x] = true;
+            }
+        }
+
+        // back to linear values that quantize to the same bytes
+        std::vector<unsigned char> rgb((size_t) crop.width * crop.height * 3);
+        if (!in.read((char *) rgb.data(), rgb.size())) {
+            std::cerr << "truncated ppm: " << part << '\n';
+            return false;
+        }
+        Tile tile{crop.x, crop.y, crop.width, crop.height};
+        tile.pixels.resize((size_t) crop.width * crop.height);
+        for (size_t i = 0; i < tile.pixels.size(); i++) {
+            tile.pixels[i] = glm::vec3{rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2]} / 255.f + glm::vec3{.5f / 255.f};
+        }
+        writer->submit(std::move(tile));
+    }
+    if (!writer || !writer->finish()) {
+        return false;
+    }
+
+    // the bounds of the pixels no part covers
+    int minX       = canvas.width;
+    int minY       = canvas.height;
+    int maxX       = -1;
+    int maxY       = -1;
+    size_t missing = 0;
+    for (int y = 0; y < canvas.height; y++) {
+        for (int x = 0; x < canvas.width; x++) {
+            if (!covered[(size_t) y * canvas.width + x]) {
+                minX = std::min(minX, x);
+                minY = std::min(minY, y);
+                maxX = std::max(maxX, x);
+                maxY = std::max(maxY, y);
+                missing++;
+            }
+        }
+    }
+    if (missing > 0) {
+        std::cerr << missing << " pixels not covered by any part, within x " << minX << " y " << minY << " width " << maxX - minX + 1 << " height " << maxY - minY + 1
+                  << '\n';
+        return false;
+    }
+    return true;
+}
+
+}   // namespace output
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "post.hpp"
+
+namespace output {
+
+/**
+ * Fixed capacity FIFO between a producer and a consumer thread.
+ * push blocks while the queue is full, pop blocks while it is empty.
+ * The two programs share no sources, rasterizer/output.hpp holds the same queue.
+ */
+template <typename T> class BoundedQueue {
+  public:
+    BoundedQueue(size_t capacity) : capacity{capacity > 0 ? capacity : 1} {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock{mutex};
+        notFull.wait(lock, [this] { return items.size() < capacity || closed; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    /**
+     * @return false once the queue is closed and fully drained
+     */
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock{mutex};
+        notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock{mutex};
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+  private:
+    size_t capacity;
+    bool closed{false};
+    std::deque<T> items{};
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+};
+
+/**
+ * A rectangle of the canvas in linear float color, row major.
+ */
+struct Tile {
+    int x;
+    int y;
+    int width;
+    int height;
+    std::vector<glm::vec3> pixels{};
+};
+
+/**
+ * The part of the canvas an image holds: the whole canvas, or a crop window that is stitched in later
+ */
+struct Crop {
+    int x;
+    int y;
+    int width;
+    int height;
+    int canvasWidth;
+    int canvasHeight;
+
+    static Crop full(int width, int height) { return Crop{0, 0, width, height, width, height}; }
+    bool isFull() const { return x == 0 && y == 0 && width == canvasWidth && height == canvasHeight; }
+};
+
+/**
+ * Clamps linear colors to [0, 1] and stores them as 8 bit rgb triplets
+ */
+void quantize(const glm::vec3 *src, int count, char *dst);
+
+/**
+ * Writes a P6 ppm from a background thread.
+ * Tiles are post processed and written to their place in the file as soon as they are submitted,
+ * in any order, so rendering the next tile overlaps the I/O of the previous one.
+ * With post.downsample > 1 tiles hold the supersampled pixels, their coordinates and sizes are multiples of the factor.
+ * A cropped image records its window in a "# crop x y canvasWidth canvasHeight" header comment,
+ * tiles keep canvas coordinates.
+ */
+class ImageWriter {
+  public:
+    /**
+     * @param queueSize amount of finished tiles that can wait for the writer before submit blocks
+     */
+    ImageWriter(const std::string &path, int width, int height, size_t queueSize = 2);
+    ImageWriter(const std::string &path, const Crop &crop, size_t queueSize = 2, const post::Options &post = {});
+    ~ImageWriter();
+
+    ImageWriter(const ImageWriter &)            = delete;
+    ImageWriter &operator=(const ImageWriter &) = delete;
+
+    void submit(Tile tile);
+
+    /**
+     * Blocks until every submitted tile is on disk.
+     * @return false if the file could not be written
+     */
+    bool finish();
+
+  private:
+    void run();
+    void writeTile(const Tile &tile);
+
+    Crop crop;
+    post::Options post;
+    std::ofstream ofs;
+    std::streamoff dataOffset{0};
+    bool failed{false};
+
+    BoundedQueue<Tile> queue;
+    std::thread worker;
+};
+
+/**
+ * Copies cropped ppm images into one image of their canvas size
+ * @return false if a part can't be read, has no crop comment, doesn't fit the canvas of the first one
+ *         or overlaps another part, or if the parts leave pixels of the canvas uncovered
+ */
+bool stitch(const std::vector<std::string> &parts, const std::string &path);
+
+}   // namespace output
@@ -0,0 +1,347 @@
+#include "pathtracer.hpp"
+
+#include "fastmath.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include <glm/geometric.hpp>
+
+namespace {
+
+const float EPSILON = 1e-3f;   // offset of secondary rays from the surface
+const float PI      = 3.14159265f;
+// largest indirect contribution of one path vertex, rare bright paths would otherwise survive as fireflies
+const float INDIRECT_CLAMP = 4.f;
+// bounces before Russian roulette may end a path, the first ones carry most of the light
+const int ROULETTE_START = 2;
+
+// splitmix64, seeded per pixel so every pixel has its own sequence
+struct Random {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z          = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+    // [0, 1)
+    float uniform() { return (next() >> 40) * (1.f / 16777216.f); }
+};
+
+struct Intersection {
+    const Sphere *sphere;
+    float t;
+};
+
+/**
+ * Closest sphere along the unit direction between EPSILON and tMax
+ */
+bool intersect(glm::vec3 origin, glm::vec3 direction, const std::vector<Sphere> &spheres, float tMax, Intersection &hit) {
+    hit = Intersection{nullptr, tMax};
+    for (const Sphere &sphere : spheres) {
+        const glm::vec3 oc = origin - sphere.getPosition();
+        const float b      = glm::dot(oc, direction);
+        const float c      = glm::dot(oc, oc) - sphere.getRadius() * sphere.getRadius();
+        const float disc   = b * b - c;
+        if (disc < 0.f) {
+            continue;
+        }
+        const float root = fastmath::sqrt(disc);
+        float t          = -b - root;
+        if (t < EPSILON) {
+            t = -b + root;   // the origin is inside the sphere
+        }
+        if (t >= EPSILON && t < hit.t) {
+            hit = Intersection{&sphere, t};
+        }
+    }
+    return hit.sphere != nullptr;
+}
+
+float luminance(glm::vec3 c) { return glm::dot(c, glm::vec3{.2126f, .7152f, .0722f}); }
+
+// Unit vector at angle acos(cosTheta) from axis, rotated by phi around it
+glm::vec3 aroundAxis(glm::vec3 axis, float cosTheta, float phi) {
+    // Duff et al., orthonormal basis without branches on the axis
+    const float sign = std::copysign(1.f, axis.z);
+    const float a    = -1.f / (sign + axis.z);
+    const float b    = axis.x * axis.y * a;
+    const glm::vec3 tangent{1.f + sign * axis.x * axis.x * a, sign * b, -sign * axis.x};
+    const glm::vec3 bitangent{b, sign + axis.y * axis.y * a, -axis.y};
+    const float sinTheta = std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+    return (tangent * std::cos(phi) + bitangent * std::sin(phi)) * sinTheta + axis * cosTheta;
+}
+
+glm::vec3 reflect(glm::vec3 direction, glm::vec3 normal) { return direction - 2.f * glm::dot(direction, normal) * normal; }
+
+/**
+ * Light of the point lights reaching point, with the same diffuse and specular terms as the Whitted renderer.
+ * Area lights contribute one random point each, the paths average them.
+ */
+glm::vec3 directLight(const scenario::Scene &scene, glm::vec3 point, glm::vec3 normal, glm::vec3 view, glm::vec3 diffuse, glm::vec3 specular, float shine, Random &random) {
+    glm::vec3 light{0.f};
+    auto add = [&](glm::vec3 lightDir, float distance, glm::vec3 diffusionIntensity, glm::vec3 specularIntensity) {
+        const float cosine = glm::dot(normal, lightDir);
+        Intersection blocker;
+        if (cosine <= 0.f || intersect(point + normal * EPSILON, lightDir, scene.spheres, distance, blocker)) {
+            return;
+        }
+        light += diffuse * diffusionIntensity * cosine;
+        if (specular != glm::vec3{0.f}) {
+            light += specular * specularIntensity * fastmath::pow(std::max(0.f, glm::dot(reflect(-lightDir, normal), view)), shine);
+        }
+    };
+    for (const scenario::PointLight &pointLight : scene.lights) {
+        const glm::vec3 toLight = pointLight.position - point;
+        const float distance    = fastmath::length(toLight);
+        add(toLight / distance, distance, pointLight.diffusionIntensity, pointLight.specularIntensity);
+    }
+    for (const scenario::AreaLight &areaLight : scene.areaLights) {
+        float distance;
+        const glm::vec3 lightDir = areaLight.sample(point, glm::vec2{random.uniform(), random.uniform()}, distance);
+        add(lightDir, distance, areaLight.diffusionIntensity, areaLight.specularIntensity);
+    }
+    return light;
+}
+
+/**
+ * Radiance arriving at origin from direction, the first hit fills albedo and normal
+ */
+glm::vec3 radiance(const scenario::Scene &scene, glm::vec3 origin, glm::vec3 direction, int bounces, Random &random, glm::vec3 &albedo, glm::vec3 &normal) {
+    glm::vec3 light{0.f};
+    glm::vec3 throughput{1.f};
+    for (int bounce = 0; bounce <= bounces; bounce++) {
+        Intersection hit;
+        if (!intersect(origin, direction, scene.spheres, std::numeric_limits<float>::infinity(), hit)) {
+            light += bounce == 0 ? scene.backColor : glm::min(throughput * scene.backColor, glm::vec3{INDIRECT_CLAMP});
+            if (bounce == 0) {
+                albedo = glm::vec3{1.f};
+                normal = glm::vec3{0.f};
+            }
+            break;
+        }
+
+        const glm::vec3 point = origin + direction * hit.t;
+        glm::vec3 n           = fastmath::normalize(point - hit.sphere->getPosition());
+        const bool entering   = glm::dot(n, direction) <= 0.f;
+        if (!entering) {
+            n = -n;
+        }
+        const material::Material &material = hit.sphere->getMaterial();
+        const glm::vec3 diffuse            = glm::max(material.diffuseConstant, glm::vec3{0.f});
+        const glm::vec3 specular           = glm::max(material.specularConstant, glm::vec3{0.f});
+        const glm::vec3 reflectance        = glm::clamp(material.ambientConstant, glm::vec3{0.f}, glm::vec3{1.f});
+        const float mirror                 = std::min(std::max(material.reflectionFraction, 0.f), 1.f);
+        const float transmission           = std::min(std::max(material.transmission, 0.f), 1.f - mirror);
+        if (bounce == 0) {
+            albedo = reflectance;
+            normal = n;
+        }
+
+        const glm::vec3 direct = throughput * (1.f - mirror - transmission) * directLight(scene, point, n, -direction, diffuse, specular, material.shineFactor, random);
+        light += bounce == 0 ? direct : glm::min(direct, glm::vec3{INDIRECT_CLAMP});
+        if (bounce == bounces) {
+            break;
+        }
+
+        // pick one lobe, its weight is the bsdf over the probability of the lobe and the direction
+        glm::vec3 side   = n;   // the side of the surface the next ray starts on
+        const float lobe = random.uniform();
+        if (lobe < mirror) {
+            direction = reflect(direction, n);
+        } else if (lobe < mirror + transmission) {
+            // reflection or refraction in proportion to the Fresnel term, the weights cancel
+            const float eta = entering ? 1.f / material.refractiveIndex : material.refractiveIndex;
+            glm::vec3 refracted;
+            if (!material::refract(direction, n, eta, refracted)) {
+                direction = reflect(direction, n);   // total internal reflection
+            } else {
+                const float cosine = entering ? -glm::dot(direction, n) : -glm::dot(refracted, n);
+                if (random.uniform() < material::schlick(cosine, material.refractiveIndex)) {
+                    direction = reflect(direction, n);
+                } else {
+                    direction = refracted;
+                    side      = -n;
+                }
+            }
+        } else {
+            const float diffuseWeight  = luminance(reflectance);
+            const float specularWeight = luminance(specular);
+            if (diffuseWeight + specularWeight <= 0.f) {
+                break;
+            }
+            const float diffuseChance = diffuseWeight / (diffuseWeight + specularWeight);
+            const float phi           = 2.f * PI * random.uniform();
+            if (random.uniform() < diffuseChance) {
+                // cosine weighted, the cosine and pdf cancel
+                direction = aroundAxis(n, std::sqrt(1.f - random.uniform()), phi);
+                throughput *= reflectance / diffuseChance;
+            } else {
+                // normalized Phong lobe around the mirror direction
+                const float shine = std::max(material.shineFactor, 0.f);
+                direction          = aroundAxis(reflect(direction, n), fastmath::pow(random.uniform(), 1.f / (shine + 1.f)), phi);
+                const float cosine = glm::dot(direction, n);
+                if (cosine <= 0.f) {
+                    break;
+                }
+                throughput *= specular * ((shine + 2.f) / (shine + 1.f) * cosine / (1.f - diffuseChance));
+            }
+        }
+        origin = point + side * EPSILON;
+
+        // Russian roulette: dim paths survive with a probability of their throughput and carry the rest
+        if (bounce + 1 >= ROULETTE_START) {
+            const float survival = std::min(1.f, std::max({throughput.r, throughput.g, throughput.b}));
+            if (random.uniform() >= survival) {
+                break;
+            }
+            throughput /= survival;
+        }
+    }
+    return light;
+}
+
+}   // namespace
+
+namespace pathtracer {
+
+Buffers trace(const scenario::Scene &scene, int x, int y, int width, int height, const Options &options) {
+    const std::vector<int> resolution = scene.canvas.getResolution();
+    const float viewPortWidth         = scene.viewPort.getRUP()[0] - scene.viewPort.getLDP()[0];
+    const float viewPortHeight        = -scene.viewPort.getRUP()[1] + scene.viewPort.getLDP()[1];
+    const float pixelWidth            = viewPortWidth / resolution[0];
+    const float pixelHeight           = viewPortHeight / resolution[1];
+    const int samples                 = std::max(1, options.samples);
+
+    const size_t count = (size_t) width * height;
+    Buffers buffers{width, height, std::vector<glm::vec3>(count), std::vector<glm::vec3>(count), std::vector<glm::vec3>(count), std::vector<float>(count)};
+    for (int j = 0; j < height; j++) {
+        for (int i = 0; i < width; i++) {
+            const int px = x + i;
+            const int py = y + j;
+            Random random{(uint64_t) py * resolution[0] + px};
+
+            glm::vec3 color{0.f};
+            glm::vec3 albedo{0.f};
+            glm::vec3 normal{0.f};
+            float luminanceSquares = 0.f;
+            for (int s = 0; s < samples; s++) {
+                // jittered inside the pixel
+                const glm::vec3 direction = fastmath::normalize(glm::vec3{pixelWidth * (px + random.uniform()) - viewPortWidth / 2,
+                                                                          pixelHeight * (py + random.uniform()) - viewPortHeight / 2, scene.viewPort.getZ()});
+                glm::vec3 sampleAlbedo, sampleNormal;
+                const glm::vec3 sample = radiance(scene, scene.camera.getPosition(), direction, options.bounces, random, sampleAlbedo, sampleNormal);
+                color += sample;
+                luminanceSquares += luminance(sample) * luminance(sample);
+                albedo += sampleAlbedo;
+                normal += sampleNormal;
+            }
+            const size_t index    = (size_t) j * width + i;
+            buffers.color[index]  = color / float(samples);
+            buffers.albedo[index] = albedo / float(samples);
+            // pixels on a silhouette average to a shorter normal
+            buffers.normal[index] = normal == glm::vec3{0.f} ? normal : fastmath::normalize(normal);
+            // variance of the mean
+            const float mean         = luminance(buffers.color[index]);
+            buffers.variance[index]  = std::max(0.f, luminanceSquares / samples - mean * mean) / samples;
+        }
+    }
+    return buffers;
+}
+
+int denoiseRadius(int iterations) { return (1 << (iterations + 1)) - 2; }
+
+void denoise(Buffers &buffers, int iterations) {
+    const float kernel[5]     = {1.f / 16, 1.f / 4, 3.f / 8, 1.f / 4, 1.f / 16};
+    const float albedoEpsilon = 1e-2f;
+    const float sigmaLight    = 4.f;    // in standard deviations of the center pixel
+    const float sigmaAlbedo   = .1f;
+    const float normalPower   = 64.f;
+    const size_t count        = buffers.color.size();
+
+    // filter the light arriving at the surface, the texture of the albedo stays sharp
+    std::vector<glm::vec3> light(count);
+    std::vector<float> variance(count);
+    for (size_t i = 0; i < count; i++) {
+        const glm::vec3 albedo = buffers.albedo[i] + albedoEpsilon;
+        light[i]               = buffers.color[i] / albedo;
+        variance[i]            = buffers.variance[i] / (luminance(albedo) * luminance(albedo));
+    }
+
+    std::vector<glm::vec3> filteredLight(count);
+    std::vector<float> filteredVariance(count);
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        const int step = 1 << iteration;
+        for (int y = 0; y < buffers.height; y++) {
+            for (int x = 0; x < buffers.width; x++) {
+                const size_t center = (size_t) y * buffers.width + x;
+                const glm::vec3 n   = buffers.normal[center];
+                if (n == glm::vec3{0.f}) {
+                    filteredLight[center]    = light[center];   // background
+                    filteredVariance[center] = variance[center];
+                    continue;
+                }
+                const float centerLuminance = luminance(light[center]);
+                const float lightScale      = sigmaLight * std::sqrt(variance[center]) + 1e-4f;
+
+                glm::vec3 sum{0.f};
+                float varianceSum = 0.f;
+                float weightSum   = 0.f;
+                for (int dy = -2; dy <= 2; dy++) {
+                    const int qy = y + dy * step;
+                    if (qy < 0 || qy >= buffers.height) {
+                        continue;
+                    }
+                    for (int dx = -2; dx <= 2; dx++) {
+                        const int qx = x + dx * step;
+                        if (qx < 0 || qx >= buffers.width) {
+                            continue;
+                        }
+                        const size_t q              = (size_t) qy * buffers.width + qx;
+                        const glm::vec3 albedoDelta = buffers.albedo[q] - buffers.albedo[center];
+                        const float weight          = kernel[dx + 2] * kernel[dy + 2] * fastmath::pow(std::max(0.f, glm::dot(n, buffers.normal[q])), normalPower)
+                                             * std::exp(-std::abs(luminance(light[q]) - centerLuminance) / lightScale - glm::dot(albedoDelta, albedoDelta) / (sigmaAlbedo * sigmaAlbedo));
+                        sum += light[q] * weight;
+                        varianceSum += variance[q] * weight * weight;
+                        weightSum += weight;
+                    }
+                }
+                filteredLight[center]    = sum / weightSum;   // the center pixel always has weight
+                filteredVariance[center] = varianceSum / (weightSum * weightSum);
+            }
+        }
+        std::swap(light, filteredLight);
+        std::swap(variance, filteredVariance);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        buffers.color[i] = light[i] * (buffers.albedo[i] + albedoEpsilon);
+    }
+}
+
+void render(const scenario::Scene &scene, output::Tile &tile, const Options &options) {
+    const std::vector<int> resolution = scene.canvas.getResolution();
+    const int margin                  = options.denoise ? denoiseRadius(options.denoiseIterations) : 0;
+    const int x0                      = std::max(0, tile.x - margin);
+    const int y0                      = std::max(0, tile.y - margin);
+    const int x1                      = std::min(resolution[0], tile.x + tile.width + margin);
+    const int y1                      = std::min(resolution[1], tile.y + tile.height + margin);
+
+    Buffers buffers = trace(scene, x0, y0, x1 - x0, y1 - y0, options);
+    if (options.denoise) {
+        denoise(buffers, options.denoiseIterations);
+    }
+
+    tile.pixels.clear();
+    tile.pixels.reserve((size_t) tile.width * tile.height);
+    for (int j = tile.y; j < tile.y + tile.height; j++) {
+        const auto row = buffers.color.begin() + (size_t) (j - y0) * buffers.width + (tile.x - x0);
+        tile.pixels.insert(tile.pixels.end(), row, row + tile.width);
+    }
+}
+
+}   // namespace pathtracer
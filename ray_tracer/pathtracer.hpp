@@ -0,0 +1,62 @@
+#pragma once
+
+#include "output.hpp"
+#include "scene.hpp"
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Monte Carlo path tracing of the scene: diffuse, glossy, mirror and refractive bounces with next event estimation
+ * to the point lights, and the background as sky light. Low sample counts are cleaned up with an
+ * edge avoiding a-trous filter guided by albedo and normal buffers.
+ * The ambient term of the Whitted renderer is left out, indirect light replaces it: the ambient constant,
+ * the color of a material under uniform light, is the reflectance of diffuse bounces and the denoiser albedo.
+ * Point lights keep the diffuse and specular terms of the Whitted renderer.
+ */
+namespace pathtracer {
+
+struct Options {
+    int samples{8};            // per pixel
+    int bounces{8};            // longest path after the camera ray, Russian roulette ends most paths earlier
+    bool denoise{true};
+    int denoiseIterations{5};  // the filter reaches 2^(iterations + 1) - 2 pixels
+};
+
+/**
+ * Noisy radiance and the feature buffers the denoiser is guided by, row major
+ */
+struct Buffers {
+    int width;
+    int height;
+    std::vector<glm::vec3> color;
+    std::vector<glm::vec3> albedo;
+    std::vector<glm::vec3> normal;   // 0 where the camera ray hits nothing
+    std::vector<float> variance;     // of the luminance of color
+};
+
+/**
+ * Traces options.samples paths through every pixel of the region x, y, width, height of the canvas.
+ * Every pixel has its own random sequence, so a region gives the same samples as the full frame.
+ */
+Buffers trace(const scenario::Scene &scene, int x, int y, int width, int height, const Options &options);
+
+/**
+ * Edge avoiding a-trous filter over buffers.color, radiance is divided by the albedo while filtering.
+ * Neighbours are weighted by normal, albedo and luminance, the luminance tolerance follows the variance.
+ */
+void denoise(Buffers &buffers, int iterations);
+
+/**
+ * How far the denoiser reads around a pixel
+ */
+int denoiseRadius(int iterations);
+
+/**
+ * Renders tile.pixels. The tile is traced with a margin of the filter radius,
+ * so denoised tiles match the full frame and can be stitched.
+ */
+void render(const scenario::Scene &scene, output::Tile &tile, const Options &options);
+
+}   // namespace pathtracer
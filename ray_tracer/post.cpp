@@ -0,0 +1,195 @@
+#include "post.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define POST_SSE 1
+#endif
+
+namespace {
+
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "rows are processed as flat float arrays");
+
+// source pixels one more post thread must get before it pays for its start
+const size_t MIN_THREAD_PIXELS = 16384;
+
+// Bayer thresholds in (0, 1), added before the truncation to 8 bit
+const float BAYER[4][4] = {
+    {.5f / 16, 8.5f / 16, 2.5f / 16, 10.5f / 16},
+    {12.5f / 16, 4.5f / 16, 14.5f / 16, 6.5f / 16},
+    {3.5f / 16, 11.5f / 16, 1.5f / 16, 9.5f / 16},
+    {15.5f / 16, 7.5f / 16, 13.5f / 16, 5.5f / 16},
+};
+
+inline float toneMap(float v, post::ToneMap map) {
+    switch (map) {
+        case post::ToneMap::REINHARD: return v / (1.f + v);
+        // Narkowicz's fit of the ACES filmic curve
+        case post::ToneMap::ACES: return (v * (2.51f * v + .03f)) / (v * (2.43f * v + .59f) + .14f);
+        default: return v;
+    }
+}
+
+// sRGB encoding, x^(1 / 2.4) approximated by a mix of repeated square roots, within .4 / 255 of the curve
+inline float encodeSrgb(float v) {
+    if (v <= .0031308f) {
+        return 12.92f * v;
+    }
+    const float s1 = std::sqrt(v);
+    const float s2 = std::sqrt(s1);
+    const float s3 = std::sqrt(s2);
+    return .585122381f * s1 + .783140355f * s2 - .368262736f * s3;
+}
+
+#ifdef POST_SSE
+inline __m128 toneMap(__m128 v, post::ToneMap map) {
+    switch (map) {
+        case post::ToneMap::REINHARD: return _mm_div_ps(v, _mm_add_ps(_mm_set1_ps(1.f), v));
+        case post::ToneMap::ACES: {
+            const __m128 numerator   = _mm_mul_ps(v, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.51f), v), _mm_set1_ps(.03f)));
+            const __m128 denominator = _mm_add_ps(_mm_mul_ps(v, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.43f), v), _mm_set1_ps(.59f))), _mm_set1_ps(.14f));
+            return _mm_div_ps(numerator, denominator);
+        }
+        default: return v;
+    }
+}
+
+inline __m128 encodeSrgb(__m128 v) {
+    const __m128 s1     = _mm_sqrt_ps(v);
+    const __m128 s2     = _mm_sqrt_ps(s1);
+    const __m128 s3     = _mm_sqrt_ps(s2);
+    const __m128 curve  = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(.585122381f), s1), _mm_mul_ps(_mm_set1_ps(.783140355f), s2)), _mm_mul_ps(_mm_set1_ps(.368262736f), s3));
+    const __m128 linear = _mm_mul_ps(_mm_set1_ps(12.92f), v);
+    const __m128 isLow  = _mm_cmple_ps(v, _mm_set1_ps(.0031308f));
+    return _mm_or_ps(_mm_and_ps(isLow, linear), _mm_andnot_ps(isLow, curve));
+}
+#endif
+
+/**
+ * Exposure, tone map, clamp, sRGB, dither and truncation of count floats, the channels need no distinction.
+ * dither holds the threshold of every float, it repeats every 12 floats (4 pixels).
+ */
+void quantizeFloats(const float *src, int count, float scale, const post::Options &options, const float *dither, unsigned char *dst) {
+    int i = 0;
+#ifdef POST_SSE
+    const __m128 scaleVector = _mm_set1_ps(scale);
+    const __m128 zero        = _mm_setzero_ps();
+    const __m128 one         = _mm_set1_ps(1.f);
+    const __m128 full        = _mm_set1_ps(255.f);
+    for (; i + 12 <= count; i += 12) {
+        __m128i quantized[3];
+        for (int k = 0; k < 3; k++) {
+            __m128 v = _mm_mul_ps(_mm_loadu_ps(src + i + 4 * k), scaleVector);
+            v        = toneMap(v, options.toneMap);
+            // min first: a NaN turns into 1 like in std::min(1.f, NaN)
+            v = _mm_max_ps(_mm_min_ps(v, one), zero);
+            if (options.srgb) {
+                v = encodeSrgb(v);
+            }
+            v = _mm_mul_ps(v, full);
+            if (options.dither) {
+                v = _mm_min_ps(_mm_add_ps(v, _mm_loadu_ps(dither + 4 * k)), full);
+            }
+            quantized[k] = _mm_cvttps_epi32(v);
+        }
+        const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(quantized[0], quantized[1]), _mm_packs_epi32(quantized[2], quantized[2]));
+        alignas(16) unsigned char packed[16];
+        _mm_store_si128((__m128i *) packed, bytes);
+        memcpy(dst + i, packed, 12);
+    }
+#endif
+    for (; i < count; i++) {
+        float v = std::max(0.f, std::min(1.f, toneMap(src[i] * scale, options.toneMap)));
+        if (options.srgb) {
+            v = encodeSrgb(v);
+        }
+        v *= 255.f;
+        if (options.dither) {
+            v = std::min(255.f, v + dither[i % 12]);
+        }
+        dst[i] = (unsigned char) v;
+    }
+}
+
+/**
+ * processRows on a block of width x rows output pixels inside a larger band
+ * @param srcStride source pixels between two source rows
+ * @param dstStride bytes between two output rows
+ */
+void processBlock(const glm::vec3 *src, size_t srcStride, int width, int rows, int x, int y, const post::Options &options, unsigned char *dst, size_t dstStride) {
+    const int factor  = std::max(1, options.downsample);
+    const float scale = std::exp2(options.exposure);
+    std::vector<glm::vec3> averaged(factor > 1 ? width : 0);
+    float dither[12] = {};
+
+    for (int row = 0; row < rows; row++) {
+        // box filter of the supersampled pixels, before anything non linear
+        const glm::vec3 *line = src + (size_t) row * factor * srcStride;
+        if (factor > 1) {
+            const float weight = 1.f / (factor * factor);
+            for (int i = 0; i < width; i++) {
+                glm::vec3 sum{0.f};
+                for (int sy = 0; sy < factor; sy++) {
+                    const glm::vec3 *block = line + (size_t) sy * srcStride + i * factor;
+                    for (int sx = 0; sx < factor; sx++) {
+                        sum += block[sx];
+                    }
+                }
+                averaged[i] = sum * weight;
+            }
+            line = averaged.data();
+        }
+        if (options.dither) {
+            for (int k = 0; k < 12; k++) {
+                dither[k] = BAYER[(y + row) & 3][(x + k / 3) & 3];
+            }
+        }
+        quantizeFloats(&line[0].x, width * 3, scale, options, dither, dst + (size_t) row * dstStride);
+    }
+}
+
+}   // namespace
+
+namespace post {
+
+void processRows(const glm::vec3 *src, int width, int rows, int x, int y, const Options &options, unsigned char *dst) {
+    processBlock(src, (size_t) width * std::max(1, options.downsample), width, rows, x, y, options, dst, (size_t) width * 3);
+}
+
+void process(const glm::vec3 *src, int width, int rows, int x, int y, const Options &options, unsigned char *dst, int threads) {
+    if (threads <= 0) {
+        threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    }
+    // the work is counted in source pixels, not rows
+    const int factor       = std::max(1, options.downsample);
+    const size_t srcPixels = (size_t) width * rows * factor * factor;
+    threads                = (int) std::max<size_t>(1, std::min<size_t>(threads, srcPixels / MIN_THREAD_PIXELS));
+    if (threads == 1) {
+        processRows(src, width, rows, x, y, options, dst);
+        return;
+    }
+    // bands of rows when there are enough of them, else stripes of columns: a 16 row tile still spreads over every thread
+    const bool byRows      = rows >= threads;
+    const size_t srcStride = (size_t) width * factor;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        const int length = byRows ? rows : width;
+        const int begin  = length * t / threads;
+        const int end    = length * (t + 1) / threads;
+        if (byRows) {
+            workers.emplace_back([=, &options] { processBlock(src + begin * factor * srcStride, srcStride, width, end - begin, x, y + begin, options, dst + (size_t) begin * width * 3, (size_t) width * 3); });
+        } else {
+            workers.emplace_back([=, &options] { processBlock(src + begin * factor, srcStride, end - begin, rows, x + begin, y, options, dst + (size_t) begin * 3, (size_t) width * 3); });
+        }
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+}   // namespace post
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+/**
+ * Turns the linear float framebuffer into 8 bit output in one pass per row:
+ * box downsample, exposure, tone map, sRGB encoding, ordered dithering and quantization.
+ * The default options only clamp to [0, 1], like the renderer always did.
+ */
+namespace post {
+
+enum class ToneMap { CLAMP, REINHARD, ACES };
+
+struct Options {
+    float exposure{0.f};               // in stops, colors are scaled by 2^exposure
+    ToneMap toneMap{ToneMap::CLAMP};
+    bool srgb{false};                  // sRGB transfer curve instead of storing linear values
+    bool dither{false};                // 4x4 Bayer matrix, spreads the quantization error of smooth gradients
+    int downsample{1};                 // the source is supersampled this many times in both directions
+
+    bool isIdentity() const { return exposure == 0.f && toneMap == ToneMap::CLAMP && !srgb && !dither && downsample == 1; }
+};
+
+/**
+ * Processes rows of output pixels into rgb bytes.
+ * @param src rows * downsample source rows of width * downsample pixels each
+ * @param x output canvas column of the first pixel, the dither pattern is fixed to the canvas
+ * @param y output canvas row of the first row
+ * @param dst rows of width * 3 bytes
+ */
+void processRows(const glm::vec3 *src, int width, int rows, int x, int y, const Options &options, unsigned char *dst);
+
+/**
+ * processRows split over threads, 0 uses every core.
+ * Each thread gets at least a few thousand source pixels, a band with fewer rows than threads is split by columns.
+ */
+void process(const glm::vec3 *src, int width, int rows, int x, int y, const Options &options, unsigned char *dst, int threads = 0);
+
+}   // namespace post
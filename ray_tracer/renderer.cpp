@@ -0,0 +1,315 @@
+#include "renderer.hpp"
+
+#include "fastmath.hpp"
+#include "sampling.hpp"
+
+#include <cmath>
+#include <limits>
+
+#include <glm/geometric.hpp>
+
+int intersectedSpheres(glm::vec3 origin, glm::vec3 direction, const std::vector<Sphere> &spheres, arena::Vector<Hit> &hits) {
+    float closestLength = std::numeric_limits<float>::infinity();
+    int closest         = -1;   // position of the closest hit in hits
+    // the same for every sphere
+    const glm::vec3 unitDirection = fastmath::normalize(direction);
+    const float directionLength   = fastmath::length(direction);
+    for (const Sphere &sphere : spheres) {
+        float length;
+        if (intersectSphere(origin, direction, unitDirection, directionLength, sphere, length)) {
+            // Use this length to keep the index of the point that is the
+            // overall closest to the camera
+            if (length <= closestLength) {
+                closest       = (int) hits.size();
+                closestLength = length;
+            }
+            hits.push_back(Hit{&sphere, length * unitDirection + origin});   // Convert the intersectionpoint to a global position
+        }
+    }
+    return closest;
+}
+
+bool closestHit(glm::vec3 origin, glm::vec3 direction, const screen::Bins::Candidate *begin, const screen::Bins::Candidate *end, Hit &hit) {
+    return closestHit(origin, direction, fastmath::normalize(direction), fastmath::length(direction), begin, end, hit);
+}
+
+bool closestHit(glm::vec3 origin, glm::vec3 direction, glm::vec3 unitDirection, float directionLength, const screen::Bins::Candidate *begin,
+                const screen::Bins::Candidate *end, Hit &hit) {
+    float closestLength           = std::numeric_limits<float>::infinity();
+    int closestIndex              = -1;
+    for (const screen::Bins::Candidate *candidate = begin; candidate != end && candidate->nearest <= closestLength; candidate++) {
+        float length;
+        if (intersectSphere(origin, direction, unitDirection, directionLength, *candidate->sphere, length)
+            && (length < closestLength || (length == closestLength && candidate->index > closestIndex))) {
+            closestLength = length;
+            closestIndex  = candidate->index;
+            hit.sphere    = candidate->sphere;
+        }
+    }
+    if (closestIndex < 0) {
+        return false;
+    }
+    hit.point = closestLength * unitDirection + origin;
+    return true;
+}
+
+bool occluded(glm::vec3 origin, glm::vec3 direction, const std::vector<Sphere> &spheres, float maxDistance) {
+    const glm::vec3 unitDirection = fastmath::normalize(direction);
+    const float directionLength   = fastmath::length(direction);
+    for (const Sphere &sphere : spheres) {
+        glm::vec3 point = sphere.getPosition() - origin;
+        if (glm::dot(direction, point) <= 0) {
+            continue;
+        }
+        const float along         = glm::dot(direction, point) / directionLength;
+        glm::vec3 projectedVector = along * unitDirection;
+        const float offset        = fastmath::length(projectedVector - point);
+        if (offset <= sphere.getRadius()) {
+            if (maxDistance == std::numeric_limits<float>::infinity()
+                || along - fastmath::sqrt(sphere.getRadius() * sphere.getRadius() - offset * offset) < maxDistance) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+namespace {
+
+/**
+ * Phong shading of one hit with the terms the material lacks compiled out
+ */
+template <bool Specular> glm::vec3 shadeHit(const scenario::Scene &scene, glm::vec3 point, glm::vec3 direction, const Sphere &sphere) {
+    const material::Material &material = sphere.getMaterial();
+    glm::vec3 ambientLight             = scene.ambientLight * material.ambientConstant;
+    glm::vec3 diffuseLight             = glm::vec3{.0f};
+    glm::vec3 specularLight            = glm::vec3{0.f};
+    const glm::vec3 normalVector       = fastmath::normalize(point - sphere.getPosition());
+    for (const scenario::PointLight &light : scene.lights) {
+        // If blocked by another sphere: skip, this is shadow
+        if (occluded(point, light.position - point, scene.spheres)) {
+            continue;
+        }
+
+        glm::vec3 lightDir = fastmath::normalize(light.position - point);
+
+        // Diffuse reflection
+        diffuseLight += material.diffuseConstant * light.diffusionIntensity * std::max(0.f, glm::dot(normalVector, lightDir));
+
+        // Specular reflection
+        if constexpr (Specular) {
+            glm::vec3 lightBounceDir = 2 * glm::dot(lightDir, normalVector) * normalVector - lightDir;
+            specularLight += material.specularConstant * light.specularIntensity * fastmath::pow(std::max(0.f, glm::dot(-(direction + scene.camera.getPosition()), lightBounceDir)), material.shineFactor);
+        }
+    }
+
+    // Area lights: the same terms averaged over points of the light
+    const uint32_t scramble = sampling::hash(fastmath::bits(point.x) ^ sampling::hash(fastmath::bits(point.y) ^ sampling::hash(fastmath::bits(point.z))));
+    for (const scenario::AreaLight &light : scene.areaLights) {
+        glm::vec3 diffuse{0.f};
+        glm::vec3 specular{0.f};
+        int visible = 0;
+        auto shoot  = [&](int index) {
+            float distance;
+            const glm::vec3 lightDir = light.sample(point, sampling::sobol2D(index, scramble), distance);
+            if (occluded(point, lightDir, scene.spheres, distance)) {
+                return;
+            }
+            visible++;
+            diffuse += material.diffuseConstant * light.diffusionIntensity * std::max(0.f, glm::dot(normalVector, lightDir));
+            if constexpr (Specular) {
+                glm::vec3 lightBounceDir = 2 * glm::dot(lightDir, normalVector) * normalVector - lightDir;
+                specular += material.specularConstant * light.specularIntensity * fastmath::pow(std::max(0.f, glm::dot(-(direction + scene.camera.getPosition()), lightBounceDir)), material.shineFactor);
+            }
+        };
+        int samples = 0;
+        for (; samples < scene.areaLightProbes; samples++) {
+            shoot(samples);
+        }
+        // Probes that disagree mean penumbra, only there the shadow needs the full sample count
+        if (visible != 0 && visible != samples) {
+            for (; samples < scene.areaLightSamples; samples++) {
+                shoot(samples);
+            }
+        }
+        diffuseLight += diffuse / float(samples);
+        specularLight += specular / float(samples);
+    }
+    if constexpr (Specular) {
+        return ambientLight + diffuseLight + specularLight;
+    } else {
+        return ambientLight + diffuseLight;
+    }
+}
+
+/**
+ * Russian roulette on the weight of a branch of the path: below scene.rouletteThreshold the branch survives
+ * with probability weight / threshold and then carries the threshold, so its expected contribution stays the same.
+ * The decision is a hash of the point, renders of any region agree.
+ * @return false if the branch ends here
+ */
+bool survives(const scenario::Scene &scene, float &weight, glm::vec3 point, uint32_t branch) {
+    if (weight >= scene.rouletteThreshold) {
+        return true;
+    }
+    const uint32_t key = sampling::hash(fastmath::bits(point.x) ^ sampling::hash(fastmath::bits(point.y) ^ sampling::hash(fastmath::bits(point.z) ^ branch)));
+    if ((key >> 8) * (1.f / 16777216.f) * scene.rouletteThreshold >= weight) {
+        return false;
+    }
+    weight = scene.rouletteThreshold;
+    return true;
+}
+
+/**
+ * Where a ray starting on the surface of sphere and pointing into it leaves the sphere again
+ */
+glm::vec3 exitPoint(glm::vec3 point, glm::vec3 unitDirection, const Sphere &sphere) {
+    const float along = -2.f * glm::dot(point - sphere.getPosition(), unitDirection);
+    return along > 0.f ? point + along * unitDirection : point;
+}
+
+template <int Remaining>
+glm::vec3 shadePath(const scenario::Scene &scene, glm::vec3 point, glm::vec3 direction, const Sphere &sphere, glm::vec3 color, float fraction, int remaining, bool inside);
+
+/**
+ * Traces a ray leaving a surface and shades what it hits with weight fraction, the background when it hits nothing.
+ * A ray that hits something with no bounces remaining adds nothing.
+ */
+template <int Remaining>
+glm::vec3 follow(const scenario::Scene &scene, glm::vec3 point, glm::vec3 direction, glm::vec3 color, float fraction, float share, int remaining) {
+    // the hits live until the pixel is done, the arena is rewound per pixel
+    arena::Vector<Hit> hits{};
+    const int closest = intersectedSpheres(point, direction, scene.spheres, hits);
+
+    // If there is no collision, return background color
+    if (closest < 0) {
+        return color + scene.backColor * fraction * share;
+    }
+    if ((Remaining > 0 ? Remaining : remaining) <= 1) {
+        return color;
+    }
+    return shadePath<(Remaining > 1 ? Remaining - 1 : 0)>(scene, hits[closest].point, direction, *hits[closest].sphere, color, fraction, remaining - 1, false);
+}
+
+/**
+ * One step of the reflection chain: adds the shading of the hit and follows the reflected and refracted rays.
+ * Remaining > 0 unrolls the chain at compile time, 0 takes the length from remaining at runtime.
+ * Materials without reflection or transmission end the chain without tracing further rays.
+ * Inside a transmissive sphere there is no local shading, the next hit is where the ray leaves the sphere.
+ */
+template <int Remaining>
+glm::vec3 shadePath(const scenario::Scene &scene, glm::vec3 point, glm::vec3 direction, const Sphere &sphere, glm::vec3 color, float fraction, int remaining, bool inside) {
+    const material::Material &material = sphere.getMaterial();
+    if (!inside) {
+        color += calculateColor(scene, point, direction, sphere) * (1 - material.reflectionFraction - material.transmission) * fraction;
+    }
+    if (!(sphere.getFeatures() & (material::REFLECTIVE | material::TRANSMISSIVE))) {
+        return color;
+    }
+    const int left = Remaining > 0 ? Remaining : remaining;
+
+    // caclulate new point, direction and sphere
+    glm::vec3 normalVector  = fastmath::normalize(point - sphere.getPosition());
+    glm::vec3 unitDirection = fastmath::normalize(direction);
+    float reflected         = material.reflectionFraction;
+
+    // the Fresnel term splits the transmitted share between the reflected and the refracted ray
+    if (sphere.getFeatures() & material::TRANSMISSIVE) {
+        const float eta = inside ? material.refractiveIndex : 1.f / material.refractiveIndex;
+        glm::vec3 refracted;
+        if (!material::refract(unitDirection, inside ? -normalVector : normalVector, eta, refracted)) {
+            reflected += material.transmission;   // total internal reflection
+        } else {
+            const float cosine  = inside ? glm::dot(refracted, normalVector) : -glm::dot(unitDirection, normalVector);
+            const float fresnel = material::schlick(cosine, material.refractiveIndex);
+            reflected += material.transmission * fresnel;
+            float weight = fraction * material.transmission * (1.f - fresnel);
+            if (left > 1 && weight > 0 && survives(scene, weight, point, 2 * remaining + 1)) {
+                color = inside ? follow<Remaining>(scene, point, refracted, color, weight, 1.f, remaining)
+                               : shadePath<(Remaining > 1 ? Remaining - 1 : 0)>(scene, exitPoint(point, refracted, sphere), refracted, sphere, color, weight, remaining - 1, true);
+            }
+        }
+    }
+
+    // the remaining fraction of color:
+    fraction = fraction * reflected;
+    if (fraction <= 0 || !survives(scene, fraction, point, 2 * remaining)) {
+        return color;
+    }
+    direction = 2 * glm::dot(-unitDirection, normalVector) * normalVector + unitDirection;
+    if (inside) {
+        if (left <= 1) {
+            return color;
+        }
+        return shadePath<(Remaining > 1 ? Remaining - 1 : 0)>(scene, exitPoint(point, direction, sphere), direction, sphere, color, fraction, remaining - 1, true);
+    }
+    return follow<Remaining>(scene, point, direction, color, fraction, reflected, remaining);
+}
+
+}   // namespace
+
+glm::vec3 calculateColor(const scenario::Scene &scene, glm::vec3 point, glm::vec3 direction, const Sphere &sphere) {
+    if (sphere.getFeatures() & material::SPECULAR) {
+        return shadeHit<true>(scene, point, direction, sphere);
+    }
+    return shadeHit<false>(scene, point, direction, sphere);
+}
+
+glm::vec3 traceReflections(const scenario::Scene &scene, glm::vec3 point, glm::vec3 direction, const Sphere &sphere) {
+    // The total fraction of all combined colors is 1
+    const glm::vec3 black{0.f};
+    switch (scene.reflectionCount) {
+        case 1: return shadePath<1>(scene, point, direction, sphere, black, 1.f, 1, false);
+        case 2: return shadePath<2>(scene, point, direction, sphere, black, 1.f, 2, false);
+        case 3: return shadePath<3>(scene, point, direction, sphere, black, 1.f, 3, false);
+        case 4: return shadePath<4>(scene, point, direction, sphere, black, 1.f, 4, false);
+        default: return scene.reflectionCount <= 0 ? black : shadePath<0>(scene, point, direction, sphere, black, 1.f, scene.reflectionCount, false);
+    }
+}
+
+void renderScene(const scenario::Scene& scene, output::Tile &tile) {
+    // Precalc
+    const std::vector<int> resolution = scene.canvas.getResolution();
+    const float viewPortWidth         = scene.viewPort.getRUP()[0] - scene.viewPort.getLDP()[0];
+    const float viewPortHeight        = -scene.viewPort.getRUP()[1] + scene.viewPort.getLDP()[1];
+    const float pixelWidth            = viewPortWidth / resolution[0];
+    const float pixelHeight           = viewPortHeight / resolution[1];
+
+    tile.pixels.clear();
+    tile.pixels.reserve(tile.width * tile.height);
+
+    // Primary rays only test the spheres binned to their screen tile, reflections take their hit lists
+    // from the arena of this thread, released after every pixel
+    const screen::Bins bins{scene, tile.x, tile.y, tile.width, tile.height};
+    arena::Arena &transient = arena::local();
+    transient.reset();
+
+    // Camera rays are normalized a row at a time through the batched normalize
+    std::vector<glm::vec3> directions(tile.width);
+    std::vector<glm::vec3> unitDirections(tile.width);
+
+    // Iterate over every pixel of the tile
+    for (int j = tile.y; j < tile.y + tile.height; j++) {
+        for (int i = 0; i < tile.width; i++) {
+            const int x       = tile.x + i;
+            directions[i]     = glm::vec3{pixelWidth * x - viewPortWidth / 2 + pixelWidth / 2, pixelHeight * j - viewPortHeight / 2 + pixelHeight / 2, scene.viewPort.getZ()};   // this is relative to the camera
+            unitDirections[i] = directions[i];
+        }
+        fastmath::normalize(unitDirections.data(), tile.width);
+
+        for (int i = tile.x; i < tile.x + tile.width; i++) {
+            arena::Scope pixel{transient};
+            glm::vec3 color {0.f};
+
+            const glm::vec3 direction = directions[i - tile.x];
+            Hit hit;
+            if (closestHit(scene.camera.getPosition(), direction, unitDirections[i - tile.x], fastmath::length(direction), bins.begin(i, j), bins.end(i, j), hit)) {
+                color = traceReflections(scene, hit.point, direction, *hit.sphere);
+            } else {
+                color = scene.backColor;
+            }
+
+            tile.pixels.push_back(color);
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "arena.hpp"
+#include "fastmath.hpp"
+#include "object.hpp"
+#include "output.hpp"
+#include "scene.hpp"
+#include "screen.hpp"
+
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct Hit {
+    const Sphere *sphere;   // points into the sphere list that was intersected
+    glm::vec3 point;        // the point of the sphere closest to the origin of the ray
+};
+
+/**
+ * The ray sphere test of intersectedSpheres, for callers that visit the spheres themselves.
+ * unitDirection and directionLength are those of direction, they are the same for every sphere.
+ * @param length distance along unitDirection to the point of the sphere closest to origin
+ * @return false if the line misses the sphere or it lies behind origin
+ */
+inline bool intersectSphere(glm::vec3 origin, glm::vec3 direction, glm::vec3 unitDirection, float directionLength, const Sphere &sphere, float &length) {
+    // Calculate everything with the origin as 0 0 0
+    glm::vec3 point = sphere.getPosition() - origin;
+    // check if the sphere is behind the direction: discard
+    if (glm::dot(direction, point) <= 0) {
+        return false;
+    }
+    glm::vec3 projectedVector = glm::dot(direction, point) / directionLength * unitDirection;
+    const float offset        = fastmath::length(projectedVector - point);
+    if (offset > sphere.getRadius()) {
+        return false;
+    }
+    // the point that is closest to the origin and on the intersected sphere
+    length = fastmath::length(projectedVector) - fastmath::sqrt(sphere.getRadius() * sphere.getRadius() - offset * offset);
+    return true;
+}
+
+/**
+ * Appends a hit for every sphere that lies in the line formed by the vector direction
+ * @return the index in hits of the hit closest to origin, -1 if nothing was hit
+ */
+int intersectedSpheres(glm::vec3 origin, glm::vec3 direction, const std::vector<Sphere> &spheres, arena::Vector<Hit> &hits);
+
+/**
+ * The closest hit among binned candidates sorted front to back, the result of intersectedSpheres for a camera ray.
+ * Stops at the first candidate that can't be closer than the best hit so far, ties go to the later sphere of the scene.
+ * @return false if nothing was hit
+ */
+bool closestHit(glm::vec3 origin, glm::vec3 direction, const screen::Bins::Candidate *begin, const screen::Bins::Candidate *end, Hit &hit);
+// With unitDirection and directionLength of direction computed by the caller, like a batch of camera rays
+bool closestHit(glm::vec3 origin, glm::vec3 direction, glm::vec3 unitDirection, float directionLength, const screen::Bins::Candidate *begin,
+                const screen::Bins::Candidate *end, Hit &hit);
+
+/**
+ * Whether any sphere lies in the line formed by the vector direction, stops at the first one
+ * @param maxDistance only spheres hit closer than this count, measured along direction
+ */
+bool occluded(glm::vec3 origin, glm::vec3 direction, const std::vector<Sphere> &spheres, float maxDistance = std::numeric_limits<float>::infinity());
+
+/**
+ * Local shading of a hit, dispatched to the kernel of the material class of the sphere
+ */
+glm::vec3 calculateColor(const scenario::Scene &scene, glm::vec3 point, glm::vec3 direction, const Sphere &sphere);
+
+/**
+ * Color of a camera ray hitting sphere at point, following reflections and refractions for up to scene.reflectionCount bounces.
+ * Russian roulette ends branches that carry little weight. Chains of up to 4 bounces are unrolled at compile time.
+ */
+glm::vec3 traceReflections(const scenario::Scene &scene, glm::vec3 point, glm::vec3 direction, const Sphere &sphere);
+
+/**
+ * Render the pixels of the canvas covered by tile into tile.pixels
+ */
+void renderScene(const scenario::Scene &scene, output::Tile &tile);
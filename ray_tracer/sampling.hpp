@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+/**
+ * Low discrepancy sample points for integrating over lights.
+ * The first two Sobol dimensions form a (0, 2) sequence: every power of two prefix is stratified
+ * over all elementary intervals, so estimates converge close to 1 / N instead of 1 / sqrt(N).
+ */
+namespace sampling {
+
+// Van der Corput, the first Sobol dimension
+inline uint32_t sobol0(uint32_t index) {
+    index = (index << 16) | (index >> 16);
+    index = ((index & 0x00ff00ffu) << 8) | ((index & 0xff00ff00u) >> 8);
+    index = ((index & 0x0f0f0f0fu) << 4) | ((index & 0xf0f0f0f0u) >> 4);
+    index = ((index & 0x33333333u) << 2) | ((index & 0xccccccccu) >> 2);
+    return ((index & 0x55555555u) << 1) | ((index & 0xaaaaaaaau) >> 1);
+}
+
+// The second Sobol dimension
+inline uint32_t sobol1(uint32_t index) {
+    uint32_t result = 0;
+    for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1) {
+        if (index & 1) {
+            result ^= v;
+        }
+    }
+    return result;
+}
+
+/**
+ * Hash of a seed, decorrelates the sequences of neighbouring pixels
+ */
+inline uint32_t hash(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+/**
+ * Point index of a 2D Sobol sequence in [0, 1)^2, digit scrambled by scramble.
+ * XOR scrambling keeps the stratification of every power of two prefix.
+ */
+inline glm::vec2 sobol2D(uint32_t index, uint32_t scramble) {
+    const uint32_t x = sobol0(index) ^ scramble;
+    const uint32_t y = sobol1(index) ^ hash(scramble);
+    return glm::vec2{(x >> 8) * (1.f / 16777216.f), (y >> 8) * (1.f / 16777216.f)};
+}
+
+}   // namespace sampling
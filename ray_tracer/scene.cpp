@@ -1,7 +1,9 @@
 #include "scene.hpp"
 #include "material.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
 #include <random>
 
@@ -62,6 +64,13 @@ void loadPointLights(const std::vector<LightDefinition>& preDefinedLights, std::
     }
 }
 
+void loadAreaLights(const std::vector<AreaLightDefinition>& definitions, std::vector<scenario::AreaLight> &lights) {
+    for (const AreaLightDefinition& light : definitions) {
+        lights.push_back({light.sphere ? scenario::AreaLight::SPHERE : scenario::AreaLight::RECT, light.position, light.radius, light.edgeU, light.edgeV,
+                          light.diffusionIntensity, light.specularIntensity});
+    }
+}
+
 void loadSpheres(const std::vector<SphereDefinition>& preDefinedSpheres, std::vector<Sphere>& spheres) {
     for (const SphereDefinition& definition : preDefinedSpheres) {
         spheres.emplace_back(definition.position, definition.radius, definition.material);
@@ -74,17 +83,53 @@ Canvas::Canvas(std::vector<int> resolution) { this->RESOLUTION = resolution; }
 
 Camera::Camera(glm::vec3 position) { this->position = position; }
 
+glm::vec3 AreaLight::sample(glm::vec3 point, glm::vec2 u, float &distance) const {
+    if (shape == RECT) {
+        const glm::vec3 toLight = position + edgeU * u.x + edgeV * u.y - point;
+        distance                = glm::length(toLight);
+        return toLight / distance;
+    }
+
+    const glm::vec3 toCenter   = position - point;
+    const float centerDistance = glm::length(toCenter);
+    const glm::vec3 axis       = toCenter / centerDistance;
+    if (centerDistance <= radius) {
+        distance = centerDistance;   // inside the light
+        return axis;
+    }
+    // uniform in the cone of directions that hit the sphere
+    const float sinMax   = radius / centerDistance;
+    const float cosMax   = std::sqrt(1.f - sinMax * sinMax);
+    const float cosTheta = 1.f - u.x * (1.f - cosMax);
+    const float sinTheta = std::sqrt(std::max(0.f, 1.f - cosTheta * cosTheta));
+    const float phi      = 6.28318531f * u.y;
+
+    // Duff et al. orthonormal basis around the axis
+    const float sign = std::copysign(1.f, axis.z);
+    const float a    = -1.f / (sign + axis.z);
+    const float b    = axis.x * axis.y * a;
+    const glm::vec3 tangent{1.f + sign * axis.x * axis.x * a, sign * b, -sign * axis.x};
+    const glm::vec3 bitangent{b, sign + axis.y * axis.y * a, -axis.y};
+    const glm::vec3 direction = (tangent * std::cos(phi) + bitangent * std::sin(phi)) * sinTheta + axis * cosTheta;
+
+    // first intersection with the light along direction
+    const float along = centerDistance * cosTheta;
+    distance          = along - std::sqrt(std::max(0.f, radius * radius - centerDistance * centerDistance * sinTheta * sinTheta));
+    return direction;
+}
+
 Scene::Scene(const Settings& settings) : camera(settings.cameraPosition), canvas(settings.resolution) {
     // Init random device
     std::random_device rd;
-    std::mt19937 gen(rd());
+    std::mt19937 gen(settings.seed != 0 ? settings.seed : rd());
 
     // Init scene
     ViewPort viewPort{};
 
-    backColor       = settings.backGroundColor;
-    ambientLight    = settings.ambientLight;
-    reflectionCount = settings.reflectionCount;
+    backColor         = settings.backGroundColor;
+    ambientLight      = settings.ambientLight;
+    reflectionCount   = settings.reflectionCount;
+    rouletteThreshold = std::max(0.f, settings.rouletteThreshold);
 
     if (settings.randomSpheres) {
         spheres = generateSpheres(settings, gen);   // this replaces the original spheres
@@ -95,6 +140,9 @@ Scene::Scene(const Settings& settings) : camera(settings.cameraPosition), canvas
 
     loadSpheres(settings.preDefinedSpheres, spheres);
     loadPointLights(settings.preDefinedLights, lights);
+    loadAreaLights(settings.preDefinedAreaLights, areaLights);
+    areaLightProbes  = std::max(1, settings.areaLightProbes);
+    areaLightSamples = std::max(areaLightProbes, settings.areaLightSamples);
 }
 
 }   // namespace scenario
\ No newline at end of file
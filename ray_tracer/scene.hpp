@@ -48,6 +48,7 @@ class Camera {
     Camera(glm::vec3 position);
 
     glm::vec3 getPosition() const { return this->position; }
+    void setPosition(glm::vec3 position) { this->position = position; }
 
   private:
     glm::vec3 position{0.0f, 0.0f, 0.0f};
@@ -59,6 +60,30 @@ struct PointLight {
     glm::vec3 specularIntensity;
 };
 
+/**
+ * A light with a surface, it casts soft shadows.
+ * Like point lights there is no falloff, every point of the light gets an equal share of the intensity.
+ */
+struct AreaLight {
+    enum Shape { SPHERE, RECT };
+
+    Shape shape;
+    glm::vec3 position;   // center of the sphere, corner of the rectangle
+    float radius;         // sphere
+    glm::vec3 edgeU;      // rectangle edges from the corner, it emits on both sides
+    glm::vec3 edgeV;
+    glm::vec3 diffusionIntensity;
+    glm::vec3 specularIntensity;
+
+    /**
+     * Maps u in [0, 1)^2 to a point of the light seen from point.
+     * Spheres are sampled uniformly over the cone they subtend, rectangles uniformly over their area.
+     * @param distance distance to the sampled point
+     * @return unit direction to the sampled point
+     */
+    glm::vec3 sample(glm::vec3 point, glm::vec2 u, float &distance) const;
+};
+
 class Scene {
   public:
     Scene(const Settings& settings);
@@ -72,8 +97,13 @@ class Scene {
     glm::vec3 ambientLight{.0f};
     std::vector<Sphere> spheres{};
     std::vector<PointLight> lights{};
+    std::vector<AreaLight> areaLights{};
+
+    int areaLightProbes;    // shadow rays before deciding whether a point is in the penumbra
+    int areaLightSamples;   // shadow rays for points in the penumbra
 
-    int reflectionCount;
+    int reflectionCount;      // hard cap
+    float rouletteThreshold;  // branch weight below which Russian roulette starts
 };
 
 }   // namespace scenario
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "screen.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// pixels added around the exact bounds, covers rounding and the approximations of the fast math mode
+const int BOUNDS_MARGIN = 2;
+
+// keeps nearest below the depths the sphere test computes, also with fast math
+const float NEAREST_SLACK = .99f;
+
+/**
+ * Slopes x / z of the two planes through the camera that contain the other axis and touch the sphere.
+ * Needs the sphere in front of the camera, center.z > radius.
+ */
+void tangentSlopes(float along, float depth, float radius, float &low, float &high) {
+    const float root        = radius * std::sqrt(along * along + depth * depth - radius * radius);
+    const float denominator = depth * depth - radius * radius;
+    low                     = (along * depth - root) / denominator;
+    high                    = (along * depth + root) / denominator;
+}
+
+}   // namespace
+
+namespace screen {
+
+CameraRays::CameraRays(const scenario::Scene &scene) {
+    const std::vector<int> resolution = scene.canvas.getResolution();
+    width                             = resolution[0];
+    height                            = resolution[1];
+    viewPortWidth                     = scene.viewPort.getRUP()[0] - scene.viewPort.getLDP()[0];
+    viewPortHeight                    = -scene.viewPort.getRUP()[1] + scene.viewPort.getLDP()[1];
+    pixelWidth                        = viewPortWidth / width;
+    pixelHeight                       = viewPortHeight / height;
+    z                                 = scene.viewPort.getZ();
+}
+
+bool bounds(const scenario::Scene &scene, const Sphere &sphere, Bounds &bounds) {
+    const CameraRays rays{scene};
+    const glm::vec3 center = sphere.getPosition() - scene.camera.getPosition();
+    const float radius     = sphere.getRadius();
+    bounds.nearest         = std::max(0.f, glm::length(center) - radius) * NEAREST_SLACK;
+
+    if (center.z <= radius) {
+        // reaches behind the camera, its silhouette is no longer bounded on the viewport
+        bounds = Bounds{0, 0, rays.width - 1, rays.height - 1, bounds.nearest};
+        return true;
+    }
+
+    // pixel i looks along x = pixelWidth * i + offsetX on the viewport plane, the same for y
+    float lowX, highX, lowY, highY;
+    tangentSlopes(center.x, center.z, radius, lowX, highX);
+    tangentSlopes(center.y, center.z, radius, lowY, highY);
+    const float offsetX = -rays.viewPortWidth / 2 + rays.pixelWidth / 2;
+    const float offsetY = -rays.viewPortHeight / 2 + rays.pixelHeight / 2;
+    const float minX    = std::floor((rays.z * lowX - offsetX) / rays.pixelWidth) - BOUNDS_MARGIN;
+    const float maxX    = std::ceil((rays.z * highX - offsetX) / rays.pixelWidth) + BOUNDS_MARGIN;
+    const float minY    = std::floor((rays.z * lowY - offsetY) / rays.pixelHeight) - BOUNDS_MARGIN;
+    const float maxY    = std::ceil((rays.z * highY - offsetY) / rays.pixelHeight) + BOUNDS_MARGIN;
+    const int width     = rays.width;
+    const int height    = rays.height;
+    if (maxX < 0.f || maxY < 0.f || minX > width - 1 || minY > height - 1) {
+        return false;
+    }
+    bounds.minX = (int) std::max(0.f, minX);
+    bounds.minY = (int) std::max(0.f, minY);
+    bounds.maxX = (int) std::min(width - 1.f, maxX);
+    bounds.maxY = (int) std::min(height - 1.f, maxY);
+    return true;
+}
+
+Bins::Bins(const scenario::Scene &scene, int x, int y, int width, int height, int tileSize)
+    : x{x}, y{y}, tileSize{tileSize}, tilesX{(width + tileSize - 1) / tileSize}, tilesY{(height + tileSize - 1) / tileSize}, offsets(tilesX * tilesY + 1, 0) {
+    // bounds in tiles of the region, front to back
+    struct Binned {
+        Candidate candidate;
+        int minX, minY, maxX, maxY;
+    };
+    std::vector<Binned> binned;
+    for (size_t s = 0; s < scene.spheres.size(); s++) {
+        Bounds sphereBounds;
+        if (!bounds(scene, scene.spheres[s], sphereBounds)) {
+            continue;
+        }
+        const int minX = std::max(sphereBounds.minX, x);
+        const int minY = std::max(sphereBounds.minY, y);
+        const int maxX = std::min(sphereBounds.maxX, x + width - 1);
+        const int maxY = std::min(sphereBounds.maxY, y + height - 1);
+        if (minX > maxX || minY > maxY) {
+            continue;
+        }
+        binned.push_back(Binned{{&scene.spheres[s], (int) s, sphereBounds.nearest}, (minX - x) / tileSize, (minY - y) / tileSize, (maxX - x) / tileSize, (maxY - y) / tileSize});
+    }
+    std::stable_sort(binned.begin(), binned.end(), [](const Binned &a, const Binned &b) { return a.candidate.nearest < b.candidate.nearest; });
+
+    // count, prefix sum, fill: the lists keep the sorted order
+    for (const Binned &b : binned) {
+        for (int ty = b.minY; ty <= b.maxY; ty++) {
+            for (int tx = b.minX; tx <= b.maxX; tx++) {
+                offsets[ty * tilesX + tx + 1]++;
+            }
+        }
+    }
+    for (size_t t = 1; t < offsets.size(); t++) {
+        offsets[t] += offsets[t - 1];
+    }
+    candidates.resize(offsets.back());
+    std::vector<int> next(offsets.begin(), offsets.end() - 1);
+    for (const Binned &b : binned) {
+        for (int ty = b.minY; ty <= b.maxY; ty++) {
+            for (int tx = b.minX; tx <= b.maxX; tx++) {
+                candidates[next[ty * tilesX + tx]++] = b.candidate;
+            }
+        }
+    }
+}
+
+}   // namespace screen
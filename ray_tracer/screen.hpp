@@ -0,0 +1,85 @@
+#pragma once
+
+#include "object.hpp"
+#include "scene.hpp"
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Where spheres land on the canvas: camera rays of the pixels and conservative screen bounds of spheres,
+ * shared by the impostor rasterizer and the tile binning of primary rays.
+ */
+namespace screen {
+
+/**
+ * Directions of the camera rays through the pixels of the canvas, relative to the camera like in renderScene
+ */
+struct CameraRays {
+    CameraRays(const scenario::Scene &scene);
+
+    glm::vec3 operator()(int i, int j) const {
+        return glm::vec3{pixelWidth * i - viewPortWidth / 2 + pixelWidth / 2, pixelHeight * j - viewPortHeight / 2 + pixelHeight / 2, z};
+    }
+
+    int width;
+    int height;
+    float viewPortWidth;
+    float viewPortHeight;
+    float pixelWidth;
+    float pixelHeight;
+    float z;   // distance of the viewport to the camera
+};
+
+/**
+ * Conservative pixel rectangle of the canvas, inclusive
+ */
+struct Bounds {
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+    float nearest;   // lower bound of the distance along a camera ray to the sphere, in any of its pixels
+};
+
+/**
+ * Pixels whose camera rays can hit the sphere: its silhouette cone cut with the viewport, widened by a pixel margin.
+ * Spheres reaching behind the camera cover the whole canvas.
+ * @return false if the sphere covers no pixel of the canvas
+ */
+bool bounds(const scenario::Scene &scene, const Sphere &sphere, Bounds &bounds);
+
+/**
+ * The spheres that can be hit in every square tile of a region of the canvas, front to back by Bounds::nearest.
+ * Lists are stored back to back, the same sphere appears in every tile its bounds overlap.
+ */
+class Bins {
+  public:
+    struct Candidate {
+        const Sphere *sphere;
+        int index;       // in scene.spheres
+        float nearest;
+    };
+
+    Bins(const scenario::Scene &scene, int x, int y, int width, int height, int tileSize = 16);
+
+    /**
+     * Candidates of the tile holding canvas pixel i, j of the region
+     */
+    const Candidate *begin(int i, int j) const { return candidates.data() + offsets[tile(i, j)]; }
+    const Candidate *end(int i, int j) const { return candidates.data() + offsets[tile(i, j) + 1]; }
+
+  private:
+    int tile(int i, int j) const { return (j - y) / tileSize * tilesX + (i - x) / tileSize; }
+
+    int x;
+    int y;
+    int tileSize;
+    int tilesX;
+    int tilesY;
+    std::vector<int> offsets;   // tilesX * tilesY + 1, candidates of tile t are [offsets[t], offsets[t + 1])
+    std::vector<Candidate> candidates;
+};
+
+}   // namespace screen
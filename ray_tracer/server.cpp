@@ -0,0 +1,283 @@
+#include "server.hpp"
+
+#include "material.hpp"
+#include "renderer.hpp"
+#include "screen.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// side of the squares the frame is traced again in
+const int STALE_TILE = 16;
+
+/**
+ * Whether a shadow ray from a point of the receiver to a point of a light ball (center, radius) can pass through the blocker.
+ * Moving the light point to the center moves the ray by at most the light radius, so the test is the one for a
+ * point light with the blocker and the receiver grown by that radius: the receiver must reach into the cone
+ * from the light through the blocker, beyond the near side of the blocker.
+ */
+bool mayShadow(glm::vec3 light, float lightRadius, const Sphere &blocker, const Sphere &receiver) {
+    const glm::vec3 toBlocker  = blocker.getPosition() - light;
+    const glm::vec3 toReceiver = receiver.getPosition() - light;
+    const float blockerRadius  = blocker.getRadius() + lightRadius;
+    const float receiverRadius = receiver.getRadius() + lightRadius;
+    const float blockerDist    = glm::length(toBlocker);
+    const float receiverDist   = glm::length(toReceiver);
+    if (blockerDist <= blockerRadius || receiverDist <= receiverRadius) {
+        return true;
+    }
+    if (receiverDist + receiverRadius < blockerDist - blockerRadius) {
+        return false;   // entirely in front of the blocker
+    }
+    const float cosine = std::min(1.f, std::max(-1.f, glm::dot(toBlocker, toReceiver) / (blockerDist * receiverDist)));
+    return std::acos(cosine) <= std::asin(blockerRadius / blockerDist) + std::asin(receiverRadius / receiverDist);
+}
+
+void writePixels(std::ostream &out, const std::vector<glm::vec3> &pixels) {
+    std::vector<char> rgb(pixels.size() * 3);
+    output::quantize(pixels.data(), (int) pixels.size(), rgb.data());
+    out.write(rgb.data(), rgb.size());
+}
+
+}   // namespace
+
+namespace server {
+
+Server::Server(scenario::Scene &scene, int threads)
+    : scene{scene}, threads{threads > 0 ? threads : (int) std::max(1u, std::thread::hardware_concurrency())}, frame{0, 0, scene.canvas.getResolution()[0], scene.canvas.getResolution()[1]},
+      tilesX{(frame.width + STALE_TILE - 1) / STALE_TILE}, tilesY{(frame.height + STALE_TILE - 1) / STALE_TILE} {
+    frame.pixels.resize((size_t) frame.width * frame.height);
+    invalidate();
+}
+
+void Server::run(std::istream &in, std::ostream &out) {
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        if (!handle(line, out)) {
+            break;
+        }
+        out.flush();
+    }
+    out.flush();
+}
+
+void Server::render(output::Tile &tile) {
+    // the stale squares the tile overlaps, each one renders on its own
+    std::vector<output::Tile> parts;
+    for (int ty = tile.y / STALE_TILE; ty <= (tile.y + tile.height - 1) / STALE_TILE; ty++) {
+        for (int tx = tile.x / STALE_TILE; tx <= (tile.x + tile.width - 1) / STALE_TILE; tx++) {
+            if (stale[ty * tilesX + tx]) {
+                stale[ty * tilesX + tx] = false;
+                const int x             = tx * STALE_TILE;
+                const int y             = ty * STALE_TILE;
+                parts.push_back(output::Tile{x, y, std::min(STALE_TILE, frame.width - x), std::min(STALE_TILE, frame.height - y)});
+            }
+        }
+    }
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < std::min(threads, (int) parts.size()); t++) {
+        workers.emplace_back([this, &parts, &next] {
+            for (size_t p = next++; p < parts.size(); p = next++) {
+                output::Tile &part = parts[p];
+                renderScene(scene, part);
+                for (int j = 0; j < part.height; j++) {
+                    std::copy_n(part.pixels.begin() + (size_t) j * part.width, part.width, frame.pixels.begin() + (size_t) (part.y + j) * frame.width + part.x);
+                }
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    tile.pixels.clear();
+    tile.pixels.reserve(tile.width * tile.height);
+    for (int j = tile.y; j < tile.y + tile.height; j++) {
+        const auto row = frame.pixels.begin() + (size_t) j * frame.width + tile.x;
+        tile.pixels.insert(tile.pixels.end(), row, row + tile.width);
+    }
+}
+
+void Server::invalidate() { stale.assign((size_t) tilesX * tilesY, true); }
+
+void Server::invalidate(const Sphere &sphere) {
+    // where the sphere itself shows
+    screen::Bounds bounds;
+    if (screen::bounds(scene, sphere, bounds)) {
+        markStale(bounds.minX, bounds.minY, bounds.maxX, bounds.maxY);
+    }
+    // Any other sphere only changes through what it reflects or refracts, which can be this sphere anywhere,
+    // or through the shadow this sphere casts on it
+    for (const Sphere &other : scene.spheres) {
+        if (&other == &sphere || !screen::bounds(scene, other, bounds)) {
+            continue;
+        }
+        bool changes = other.getFeatures() & (material::REFLECTIVE | material::TRANSMISSIVE);
+        for (size_t l = 0; !changes && l < scene.lights.size(); l++) {
+            changes = mayShadow(scene.lights[l].position, 0.f, sphere, other);
+        }
+        for (size_t l = 0; !changes && l < scene.areaLights.size(); l++) {
+            const scenario::AreaLight &light = scene.areaLights[l];
+            if (light.shape == scenario::AreaLight::SPHERE) {
+                changes = mayShadow(light.position, light.radius, sphere, other);
+            } else {
+                const glm::vec3 diagonal = light.edgeU + light.edgeV;
+                changes                  = mayShadow(light.position + diagonal * .5f, glm::length(diagonal) * .5f, sphere, other);
+            }
+        }
+        if (changes) {
+            markStale(bounds.minX, bounds.minY, bounds.maxX, bounds.maxY);
+        }
+    }
+}
+
+void Server::markStale(int minX, int minY, int maxX, int maxY) {
+    for (int ty = minY / STALE_TILE; ty <= maxY / STALE_TILE; ty++) {
+        for (int tx = minX / STALE_TILE; tx <= maxX / STALE_TILE; tx++) {
+            stale[ty * tilesX + tx] = true;
+        }
+    }
+}
+
+bool Server::handle(const std::string &line, std::ostream &out) {
+    std::istringstream args{line};
+    std::string command;
+    args >> command;
+    const std::vector<int> resolution = scene.canvas.getResolution();
+
+    if (command == "quit") {
+        out << "ok\n";
+        return false;
+    }
+
+    if (command == "render" || command == "tile") {
+        output::Tile tile{0, 0, resolution[0], resolution[1]};
+        std::string path;
+        if (command == "tile" && !(args >> tile.x >> tile.y >> tile.width >> tile.height)) {
+            out << "error usage: tile x y width height\n";
+            return true;
+        }
+        if (command == "render") {
+            args >> path;
+        }
+        if (tile.x < 0 || tile.y < 0 || tile.width <= 0 || tile.height <= 0 || tile.x + tile.width > resolution[0] || tile.y + tile.height > resolution[1]) {
+            out << "error tile outside the canvas\n";
+            return true;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        render(tile);
+        const long ms = (long) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+        if (!path.empty()) {
+            output::ImageWriter writer{path, tile.width, tile.height};
+            writer.submit(std::move(tile));
+            if (!writer.finish()) {
+                out << "error can't write " << path << '\n';
+            } else {
+                out << "ok " << ms << '\n';
+            }
+        } else if (command == "render") {
+            out << "ok frame " << tile.width << ' ' << tile.height << ' ' << ms << '\n';
+            writePixels(out, tile.pixels);
+        } else {
+            out << "ok tile " << tile.x << ' ' << tile.y << ' ' << tile.width << ' ' << tile.height << ' ' << ms << '\n';
+            writePixels(out, tile.pixels);
+        }
+        return true;
+    }
+
+    // everything below edits the scene
+    bool valid = false;
+    std::string reply;
+    if (command == "camera") {
+        glm::vec3 position;
+        if ((valid = (bool) (args >> position.x >> position.y >> position.z))) {
+            scene.camera.setPosition(position);
+            invalidate();
+        }
+    } else if (command == "sphere") {
+        glm::vec3 position;
+        float radius;
+        std::string name;
+        if ((valid = (bool) (args >> position.x >> position.y >> position.z >> radius >> name))) {
+            const std::vector<std::string> names = material::getMaterialNames();
+            if (std::find(names.begin(), names.end(), name) == names.end()) {
+                out << "error unknown material " << name << '\n';
+                return true;
+            }
+            material::Material material = material::getMaterialProperties(name);
+            // random color if unvalid diffuse constant, like generateSpheres with the default color ranges
+            if (material.ambientConstant[0] < 0) {
+                std::uniform_real_distribution<float> unit(0.f, 1.f);
+                material.ambientConstant = glm::vec3{unit(random), unit(random), unit(random)};
+            }
+            scene.spheres.emplace_back(position, radius, material);
+            invalidate(scene.spheres.back());
+            reply = ' ' + std::to_string(scene.spheres.size() - 1);
+        }
+    } else if (command == "move" || command == "remove") {
+        size_t index;
+        glm::vec3 position;
+        valid = (bool) (args >> index) && index < scene.spheres.size() && (command == "remove" || (bool) (args >> position.x >> position.y >> position.z));
+        if (valid) {
+            invalidate(scene.spheres[index]);
+        }
+        if (valid && command == "move") {
+            scene.spheres[index].setPosition(position);
+            invalidate(scene.spheres[index]);
+        } else if (valid) {
+            scene.spheres.erase(scene.spheres.begin() + index);
+        }
+    } else if (command == "light") {
+        size_t index;
+        glm::vec3 position;
+        if ((valid = (bool) (args >> index >> position.x >> position.y >> position.z) && index <= scene.lights.size())) {
+            if (index == scene.lights.size()) {
+                scene.lights.push_back({position, glm::vec3{1.f}, glm::vec3{1.f}});
+            }
+            scenario::PointLight &light = scene.lights[index];
+            light.position              = position;
+            glm::vec3 intensity;
+            if (args >> intensity.r >> intensity.g >> intensity.b) {
+                light.diffusionIntensity = intensity;
+                light.specularIntensity  = intensity;
+            }
+            invalidate();
+        }
+    } else if (command == "background") {
+        glm::vec3 color;
+        if ((valid = (bool) (args >> color.r >> color.g >> color.b))) {
+            scene.backColor = color;
+            invalidate();
+        }
+    } else if (command == "reflections") {
+        int count;
+        if ((valid = (bool) (args >> count) && count >= 0)) {
+            scene.reflectionCount = count;
+            invalidate();
+        }
+    } else {
+        out << "error unknown command " << command << '\n';
+        return true;
+    }
+
+    if (!valid) {
+        out << "error bad arguments: " << line << '\n';
+        return true;
+    }
+    out << "ok" << reply << '\n';
+    return true;
+}
+
+}   // namespace server
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "output.hpp"
+#include "scene.hpp"
+
+#include <istream>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace server {
+
+/**
+ * Keeps a scene resident and renders it on request, so startup and scene building are paid once.
+ * The protocol is line based, every command is answered with a line starting with "ok" or "error":
+ *   camera x y z                 move the camera
+ *   sphere x y z radius material add a sphere, answers its index
+ *   move index x y z             move a sphere
+ *   remove index                 remove a sphere
+ *   light index x y z [r g b]    move a light and optionally set its intensity, index == light count adds one
+ *   background r g b
+ *   reflections n
+ *   render [path]                write the frame as a ppm to path, or answer "ok frame width height ms"
+ *                                followed by width * height rgb bytes
+ *   tile x y width height        answer "ok tile x y width height ms" followed by the rgb bytes of the tile
+ *   quit
+ * The frame stays cached between requests. A sphere edit only marks the pixels it can change for tracing again:
+ * the screen bounds of the sphere before and after, of every reflective or transmissive sphere,
+ * and of the spheres that can fall into its shadow. Camera, light, background and reflection edits redo the frame.
+ */
+class Server {
+  public:
+    /**
+     * @param threads render threads, 0 uses one per hardware thread
+     */
+    Server(scenario::Scene &scene, int threads = 0);
+
+    /**
+     * Serves commands until quit or the end of the input
+     */
+    void run(std::istream &in, std::ostream &out);
+
+  private:
+    // false once the session is over
+    bool handle(const std::string &line, std::ostream &out);
+    // traces the stale squares of the frame that overlap the tile on all threads, then copies the tile out of the frame
+    void render(output::Tile &tile);
+
+    // marks the whole frame stale
+    void invalidate();
+    // marks the pixels a sphere at this place can change, call it for the old and the new place of an edit
+    void invalidate(const Sphere &sphere);
+    // marks the squares of the frame that overlap a rectangle of pixels, inclusive
+    void markStale(int minX, int minY, int maxX, int maxY);
+
+    scenario::Scene &scene;
+    int threads;
+    std::mt19937 random;   // colors of the random_color materials
+
+    output::Tile frame;
+    int tilesX;
+    int tilesY;
+    std::vector<bool> stale;   // per square of STALE_TILE pixels of the frame
+};
+
+}   // namespace server
@@ -17,6 +17,16 @@ struct LightDefinition {
     glm::vec3 specularIntensity;
 };
 
+struct AreaLightDefinition {
+    bool sphere;          // a sphere, otherwise a rectangle
+    glm::vec3 position;   // center of the sphere, corner of the rectangle
+    float radius;
+    glm::vec3 edgeU;
+    glm::vec3 edgeV;
+    glm::vec3 diffusionIntensity;
+    glm::vec3 specularIntensity;
+};
+
 struct RandomSphereSettings {
     float xMin = -5.f;
     float xMax = 5.f;
@@ -65,8 +75,23 @@ struct Settings {
 
     std::vector<SphereDefinition> preDefinedSpheres{};
     std::vector<LightDefinition> preDefinedLights{};
+    std::vector<AreaLightDefinition> preDefinedAreaLights{};
+
+    // Soft shadows: a few stratified probes per area light, the full count only where they disagree
+    int areaLightProbes  = 4;
+    int areaLightSamples = 32;
+
+    // Hard cap on the length of reflection and refraction chains. Branches whose weight drops below
+    // rouletteThreshold are ended by Russian roulette long before, 0 traces every chain to the cap.
+    int reflectionCount     = 8;
+    float rouletteThreshold = .1f;
+
+    // Seed of the random scene, 0 draws a new scene every run. Crops of one image need the same seed.
+    unsigned seed = 0;
 
-    int reflectionCount = 3;
+    // Output
+    int tileRows        = 16;   // rows rendered before they are handed to the writer
+    int writerQueueSize = 2;    // finished bands allowed to wait for the writer
 
     bool debug = true;
 };
\ No newline at end of file